@@ -0,0 +1,575 @@
+#pragma once
+
+#include "FileSystem.h"
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <future>
+#include <optional>
+#include <thread>
+#include <utility>
+
+/* -------------------- Executors -------------------- */
+
+class Executor
+{
+public:
+    virtual ~Executor() = default;
+
+    virtual void post(std::function<void()> fn) = 0;
+
+    // co_await ex.schedule() suspends the caller and resumes it from the executor's queue
+    auto schedule()
+    {
+        struct Awaiter
+        {
+            Executor &ex;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) { ex.post([h]
+                                                                    { h.resume(); }); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+};
+
+// Single threaded run loop, everything posted runs on the thread calling run()
+class EventLoop : public Executor
+{
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> queue;
+    bool stopped = false;
+
+public:
+    void post(std::function<void()> fn) override
+    {
+        {
+            std::lock_guard lock(m);
+            queue.push_back(std::move(fn));
+        }
+        cv.notify_one();
+    }
+
+    // Make run() return once the callback currently executing finishes
+    void stop()
+    {
+        {
+            std::lock_guard lock(m);
+            stopped = true;
+        }
+        cv.notify_all();
+    }
+
+    void run()
+    {
+        while (true)
+        {
+            std::function<void()> fn;
+            {
+                std::unique_lock lock(m);
+                cv.wait(lock, [&]
+                        { return stopped || !queue.empty(); });
+                if (stopped)
+                {
+                    stopped = false;
+                    return;
+                }
+                fn = std::move(queue.front());
+                queue.pop_front();
+            }
+            fn();
+        }
+    }
+};
+
+class ThreadPoolExecutor : public Executor
+{
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+public:
+    explicit ThreadPoolExecutor(size_t threads = std::thread::hardware_concurrency())
+    {
+        for (size_t i = 0; i < std::max<size_t>(threads, 1); i++)
+        {
+            workers.emplace_back([this]
+                                 {
+                while (true)
+                {
+                    std::function<void()> fn;
+                    {
+                        std::unique_lock lock(m);
+                        cv.wait(lock, [&] { return stopping || !queue.empty(); });
+                        if (queue.empty())
+                            return;
+                        fn = std::move(queue.front());
+                        queue.pop_front();
+                    }
+                    fn();
+                } });
+        }
+    }
+
+    ~ThreadPoolExecutor()
+    {
+        {
+            std::lock_guard lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto &t : workers)
+            t.join();
+    }
+
+    void post(std::function<void()> fn) override
+    {
+        {
+            std::lock_guard lock(m);
+            queue.push_back(std::move(fn));
+        }
+        cv.notify_one();
+    }
+};
+
+/* -------------------- Task -------------------- */
+
+// Lazily started coroutine; runs when awaited and resumes the awaiter on completion
+template <typename T = void>
+class Task;
+
+struct TaskPromiseBase
+{
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            return h.promise().continuation;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+template <typename T>
+class Task
+{
+public:
+    struct promise_type : TaskPromiseBase
+    {
+        std::optional<T> value;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_value(T v) { value = std::move(v); }
+    };
+
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task(const Task &) = delete;
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter)
+    {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+
+    T await_resume()
+    {
+        if (handle.promise().error)
+            std::rethrow_exception(handle.promise().error);
+        return std::move(*handle.promise().value);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <>
+class Task<void>
+{
+public:
+    struct promise_type : TaskPromiseBase
+    {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_void() {}
+    };
+
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task(const Task &) = delete;
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter)
+    {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+
+    void await_resume()
+    {
+        if (handle.promise().error)
+            std::rethrow_exception(handle.promise().error);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Fire-and-forget coroutine frame used to drive a Task from plain code
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Start task on the executor without waiting for it; done receives the error, if any
+template <typename T>
+DetachedTask spawn(Executor &ex, Task<T> task, std::function<void(std::exception_ptr)> done = {})
+{
+    co_await ex.schedule();
+    std::exception_ptr error;
+    try
+    {
+        co_await task;
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    if (done)
+        done(error);
+}
+
+// Block the calling thread until task finishes. Must not be called from the
+// thread that runs the executor the task depends on.
+template <typename T>
+T syncWait(Task<T> task)
+{
+    // the promise lives in the coroutine frame: set_value may still be
+    // running on another thread when get() returns here
+    std::promise<T> result;
+    auto future = result.get_future();
+    [](Task<T> t, std::promise<T> out) -> DetachedTask
+    {
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                co_await t;
+                out.set_value();
+            }
+            else
+            {
+                out.set_value(co_await t);
+            }
+        }
+        catch (...)
+        {
+            out.set_exception(std::current_exception());
+        }
+    }(std::move(task), std::move(result));
+    return future.get();
+}
+
+/* -------------------- AsyncFileSystem -------------------- */
+
+struct AsyncOptions
+{
+    size_t sliceNodes = 512;      // nodes copied or freed before yielding
+    size_t sliceBytes = 1u << 20; // file bytes copied before yielding
+};
+
+// Awaitable front end for FileSystem. Operations whose cost is bounded run
+// inline on the awaiting thread; cp, recursive rm and large reads work in
+// slices and yield to the executor between them, so one big call can't
+// monopolise an event loop. Arguments are taken by value since the
+// coroutine frame outlives the caller's expression.
+class AsyncFileSystem
+{
+private:
+    FileSystem &fs;
+    Executor &ex;
+    AsyncOptions opts;
+
+public:
+    AsyncFileSystem(FileSystem &_fs, Executor &_ex, AsyncOptions _opts = {}) : fs(_fs), ex(_ex), opts(_opts) {}
+
+    Executor &executor() { return ex; }
+
+    Task<> mkdir(std::string path)
+    {
+        fs.mkdir(path);
+        co_return;
+    }
+
+    Task<> touch(std::string path)
+    {
+        fs.touch(path);
+        co_return;
+    }
+
+    Task<> write(std::string path, std::string content)
+    {
+        fs.write(path, content);
+        co_return;
+    }
+
+    Task<> append(std::string path, std::string content)
+    {
+        fs.append(path, content);
+        co_return;
+    }
+
+    Task<std::vector<std::string>> ls(std::string path)
+    {
+        co_return fs.ls(path);
+    }
+
+    Task<> mv(std::string src, std::string dest)
+    {
+        fs.mv(src, dest);
+        co_return;
+    }
+
+    Task<> printTree(std::string path = "/")
+    {
+        fs.printTree(path);
+        co_return;
+    }
+
+    Task<> mkdirs(std::string path)
+    {
+        fs.mkdirs(path);
+        co_return;
+    }
+
+    // du and find walk the subtree in one go under the shared lock, as the
+    // synchronous calls do
+    Task<size_t> du(std::string path)
+    {
+        co_return fs.du(path);
+    }
+
+    Task<std::vector<std::string>> find(std::string path, std::string pattern = "*")
+    {
+        co_return fs.find(path, pattern);
+    }
+
+    Task<> setxattr(std::string path, std::string name, std::string value)
+    {
+        fs.setxattr(path, name, value);
+        co_return;
+    }
+
+    Task<std::string> getxattr(std::string path, std::string name)
+    {
+        co_return fs.getxattr(path, name);
+    }
+
+    Task<std::vector<std::string>> listxattr(std::string path)
+    {
+        co_return fs.listxattr(path);
+    }
+
+    Task<> removexattr(std::string path, std::string name)
+    {
+        fs.removexattr(path, name);
+        co_return;
+    }
+
+    Task<std::string> read(std::string path)
+    {
+        std::shared_ptr<FileNode> file;
+        std::string out;
+        {
+            std::shared_lock lock(fs.treeMutex);
+            auto node = fs.traverseNode(path);
+            if (node->type != NodeType::File)
+                throw std::runtime_error(path + " is a directory");
+            file = std::static_pointer_cast<FileNode>(node);
+            fs.noteRead(*file);
+            out.resize(file->size());
+        }
+
+        // the result has the size seen at the start; a concurrent shrink truncates it
+        size_t offset = 0;
+        while (offset < out.size())
+        {
+            {
+                std::shared_lock lock(fs.treeMutex);
+                size_t end = std::min(out.size(), file->size());
+                if (offset >= end)
+                {
+                    out.resize(offset);
+                    break;
+                }
+                size_t n = std::min(opts.sliceBytes, end - offset);
+                if (fs.verifyOnRead && !file->verify(offset, n))
+                    throw std::runtime_error("Checksum mismatch in " + path);
+                std::copy_n(file->data.begin() + offset, n, out.begin() + offset);
+                offset += n;
+            }
+            if (offset < out.size())
+                co_await ex.schedule();
+        }
+        co_return out;
+    }
+
+    Task<> rm(std::string path, bool recursive = false)
+    {
+        std::shared_ptr<INode> detached;
+        {
+            std::unique_lock lock(fs.treeMutex);
+            detached = fs.detachNode(path, recursive);
+        }
+
+        // Dismantle the unlinked subtree a slice at a time instead of letting the
+        // last shared_ptr free it in one go. Nodes still referenced elsewhere
+        // (e.g. by an in-flight cp) are simply released.
+        std::vector<std::shared_ptr<INode>> pending{std::move(detached)};
+        while (!pending.empty())
+        {
+            for (size_t n = 0; n < opts.sliceNodes && !pending.empty(); n++)
+            {
+                auto node = std::move(pending.back());
+                pending.pop_back();
+                if (node->type == NodeType::Directory && node.use_count() == 1)
+                {
+                    auto dir = std::static_pointer_cast<DirectoryNode>(node);
+                    dir->children.forEach([&](const std::string &, const std::shared_ptr<INode> &child)
+                                          { pending.push_back(child); });
+                    dir->children.clear();
+                }
+            }
+            if (!pending.empty())
+                co_await ex.schedule();
+        }
+    }
+
+    Task<> cp(std::string src, std::string dest)
+    {
+        std::shared_ptr<INode> srcNode;
+        {
+            std::shared_lock lock(fs.treeMutex);
+            srcNode = fs.traverseNode(src);
+        }
+
+        // Build the copy off-tree, then link it in one step. Sources modified
+        // while the copy is in flight may be picked up partially.
+        struct Pending
+        {
+            std::shared_ptr<INode> src;
+            std::string name;
+            std::shared_ptr<DirectoryNode> parentCopy;
+            std::shared_ptr<FileNode> fileCopy; // set while a large file is copied in chunks
+            size_t size = 0;                    // source size when the chunked copy started
+        };
+        std::shared_ptr<INode> copyRoot;
+        std::vector<Pending> pending{{srcNode, srcNode->name, nullptr, nullptr, 0}};
+
+        while (!pending.empty())
+        {
+            {
+                std::shared_lock lock(fs.treeMutex);
+                size_t nodes = 0, bytes = 0;
+                while (!pending.empty() && nodes < opts.sliceNodes && bytes < opts.sliceBytes)
+                {
+                    Pending &top = pending.back();
+                    if (top.fileCopy)
+                    {
+                        auto srcFile = std::static_pointer_cast<FileNode>(top.src);
+                        size_t offset = top.fileCopy->size();
+                        size_t end = std::min(srcFile->size(), top.size);
+                        size_t n = std::min(opts.sliceBytes - bytes, end - std::min(offset, end));
+                        top.fileCopy->appendData(srcFile->data.data() + offset, n);
+                        bytes += n;
+                        if (offset + n >= end)
+                            pending.pop_back();
+                        continue;
+                    }
+
+                    Pending item = std::move(top);
+                    pending.pop_back();
+                    nodes++;
+
+                    std::shared_ptr<INode> copy;
+                    if (item.src->type == NodeType::File)
+                    {
+                        auto srcFile = std::static_pointer_cast<FileNode>(item.src);
+                        if (srcFile->size() <= opts.sliceBytes)
+                        {
+                            copy = srcFile->cloneShallow();
+                            bytes += srcFile->size();
+                        }
+                        else
+                        {
+                            auto f = makeNode<FileNode>(srcFile->name);
+                            f->copyMetadata(*srcFile);
+                            f->data.reserve(srcFile->size());
+                            pending.push_back({item.src, item.name, nullptr, f, srcFile->size()});
+                            copy = f;
+                        }
+                    }
+                    else
+                    {
+                        auto srcDir = std::static_pointer_cast<DirectoryNode>(item.src);
+                        auto d = std::static_pointer_cast<DirectoryNode>(srcDir->cloneShallow());
+                        srcDir->children.forEach([&](const std::string &name, const std::shared_ptr<INode> &child)
+                                                 { pending.push_back({child, name, d, nullptr, 0}); });
+                        copy = d;
+                    }
+
+                    copy->name = item.name;
+                    if (item.parentCopy)
+                        item.parentCopy->addChild(item.name, copy);
+                    else
+                        copyRoot = copy;
+                }
+            }
+            if (!pending.empty())
+                co_await ex.schedule();
+        }
+
+        std::vector<std::shared_ptr<INode>> evicted; // freed after the lock is released
+        std::unique_lock lock(fs.treeMutex);
+        fs.placeCopy(srcNode->name, dest, [&]
+                     { return copyRoot; });
+        fs.enforceCacheLimit(nullptr, evicted);
+    }
+};
@@ -0,0 +1,1496 @@
+#include "AsyncFileSystem.h"
+#include "HostTransfer.h"
+#include "NodeTable.h"
+#include "ObjectStore.h"
+#include "TarArchive.h"
+#include "TtlExpirer.h"
+#if defined(__linux__)
+#include "IpcClient.h"
+#include "IpcServer.h"
+#include "ShmFileSystem.h"
+#include <sys/wait.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <list>
+#include <map>
+#include <sstream>
+#include <thread>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+/* -------------------- Helpers -------------------- */
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static double percentile(std::vector<double> v, double p)
+{
+    if (v.empty())
+        return 0;
+    sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+// /src/d<i>/f<j> with `dirs` x `files` files of `fileSize` bytes
+static void buildTree(FileSystem &fs, const std::string &base, int dirs, int files, size_t fileSize)
+{
+    std::string payload(fileSize, 'x');
+    fs.mkdir(base);
+    for (int i = 0; i < dirs; i++)
+    {
+        std::string dir = base + "/d" + std::to_string(i);
+        fs.mkdir(dir);
+        for (int j = 0; j < files; j++)
+            fs.write(dir + "/f" + std::to_string(j), payload);
+    }
+}
+
+/* -------------------- alloc: file buffer allocation -------------------- */
+
+// Threads each grow and recycle 2000 file buffers with appends of mixed sizes,
+// once with std::vector<char> on the global allocator and once with FileData
+// (PooledBuffer on BufferAllocator).
+template <typename Buffer>
+static double appendRun(int threads, int rounds)
+{
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([=]
+                             {
+            std::vector<Buffer> files(2000);
+            char chunk[4096] = {};
+            uint32_t rng = 12345 + t;
+            for (int r = 0; r < rounds; r++)
+            {
+                rng = rng * 1664525 + 1013904223;
+                auto &f = files[rng % files.size()];
+                size_t n = 1 + (rng >> 8) % sizeof(chunk);
+                if (f.size() > 64 * 1024)
+                    Buffer().swap(f); // the file is rewritten from scratch
+                if constexpr (std::is_same_v<Buffer, FileData>)
+                    f.append(chunk, n);
+                else
+                    f.insert(f.end(), chunk, chunk + n);
+            } });
+    for (auto &w : workers)
+        w.join();
+    return (double)threads * rounds / (elapsedMs(start) / 1000);
+}
+
+static void benchAlloc(const std::vector<std::string> &)
+{
+    const int rounds = 400000;
+    for (int threads : {1, 2, 4, 8})
+    {
+        // warm-up runs first, so neither side is measured faulting in fresh memory
+        appendRun<std::vector<char>>(threads, rounds);
+        double plain = appendRun<std::vector<char>>(threads, rounds);
+        appendRun<FileData>(threads, rounds);
+        auto before = BufferAllocator::instance().stats();
+        auto start = Clock::now();
+        double pooled = appendRun<FileData>(threads, rounds);
+        double secs = elapsedMs(start) / 1000;
+        auto after = BufferAllocator::instance().stats();
+        std::cout << threads << " threads: std::allocator " << plain / 1e6 << " M appends/s, BufferAllocator "
+                  << pooled / 1e6 << " M appends/s, " << (after.allocations - before.allocations) / secs / 1e6
+                  << " M allocs/s\n";
+    }
+
+    // fragmentation with a live population of mixed-size files and their
+    // directory tables (FileData reports its real size and uses the rounding
+    // as spare capacity)
+    std::vector<FileData> live(100000);
+    std::vector<ChildMap> tables(1000);
+    uint32_t rng = 7;
+    for (size_t i = 0; i < live.size(); i++)
+    {
+        rng = rng * 1664525 + 1013904223;
+        live[i].resize(1 + (rng >> 8) % 20000);
+        tables[i % tables.size()].insert("f" + std::to_string(i), nullptr);
+    }
+    auto s = BufferAllocator::instance().stats();
+    std::cout << "100k live files: " << s.requestedBytes / (1 << 20) << " MiB requested, " << s.blockBytes / (1 << 20)
+              << " MiB in blocks, " << s.slabBytes / (1 << 20) << " MiB of slabs (kept from the runs above); "
+              << "internal fragmentation " << s.internalFragmentation() * 100 << "%, external "
+              << s.externalFragmentation() * 100 << "%\n";
+}
+
+/* -------------------- analytics: columnar vs pointer-walking scans -------------------- */
+
+// "Bytes by extension modified in the last hour" over 200k files, answered by
+// walking the INodes and by a NodeTable snapshot
+static void benchAnalytics(const std::vector<std::string> &)
+{
+    const char *exts[] = {"txt", "json", "bin", "log", "csv", "png", "tar", ""};
+    FileSystem fs;
+    fs.mkdir("/data");
+    for (int i = 0; i < 400; i++)
+    {
+        std::string dir = "/data/d" + std::to_string(i);
+        fs.mkdir(dir);
+        for (int j = 0; j < 500; j++)
+        {
+            const char *e = exts[(i * 31 + j) % 8];
+            std::string path = dir + "/f" + std::to_string(j) + (*e ? "." : "") + e;
+            fs.write(path, std::string((i * 7 + j * 13) % 2048, 'a'));
+        }
+    }
+    time_t since = time(nullptr) - 3600;
+
+    auto start = Clock::now();
+    NodeTable table(fs);
+    double buildMs = elapsedMs(start);
+
+    const int rounds = 20;
+    std::vector<ExtensionUsage> walked, scanned;
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        walked = NodeTable::walkBytesByExtension(fs, "/", since);
+    double walkMs = elapsedMs(start) / rounds;
+
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        scanned = table.bytesByExtension(since);
+    double tableMs = elapsedMs(start) / rounds;
+
+    volatile uint64_t sink = 0;
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+        sink = sink + table.sizeHistogram()[11] + table.typeCounts().first;
+    double histMs = elapsedMs(start) / rounds;
+
+    bool match = walked.size() == scanned.size() &&
+                 std::equal(walked.begin(), walked.end(), scanned.begin(), [](auto &a, auto &b)
+                            { return a.extension == b.extension && a.bytes == b.bytes; });
+    std::cout << table.nodeCount() << " nodes, table built in " << buildMs << " ms\n";
+    std::cout << "bytes by extension: pointer walk " << walkMs << " ms, columnar " << tableMs << " ms ("
+              << walkMs / tableMs << "x, results " << (match ? "match" : "DIFFER") << ")\n";
+    std::cout << "size histogram + type counts: " << histMs << " ms\n";
+}
+
+/* -------------------- async: event loop latency during cp -------------------- */
+
+// Runs a ticker on an EventLoop next to a large cp and reports the gaps between
+// ticks, i.e. how long the loop was unable to serve anything else.
+static void benchAsync(const std::vector<std::string> &)
+{
+    FileSystem fs;
+    buildTree(fs, "/src", 200, 500, 1024);
+
+    auto measure = [&](const char *label, const std::function<void(EventLoop &, std::function<void()>)> &startCp)
+    {
+        EventLoop loop;
+        std::vector<double> gaps;
+        bool done = false;
+        auto last = Clock::now();
+        auto start = Clock::now();
+        double cpMs = 0;
+
+        std::function<void()> tick = [&]
+        {
+            auto now = Clock::now();
+            gaps.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+            last = now;
+            if (done)
+                loop.stop();
+            else
+                loop.post(tick);
+        };
+        loop.post(tick);
+        startCp(loop, [&]
+                {
+            cpMs = elapsedMs(start);
+            done = true; });
+        loop.run();
+
+        std::cout << label << ": cp " << cpMs << " ms, ticks " << gaps.size()
+                  << ", p99 gap " << percentile(gaps, 0.99) << " ms, max gap "
+                  << percentile(gaps, 1.0) << " ms\n";
+    };
+
+    measure("blocking cp", [&](EventLoop &loop, std::function<void()> done)
+            { loop.post([&fs, done]
+                        {
+                fs.cp("/src", "/blocking");
+                done(); }); });
+
+    measure("async cp   ", [&](EventLoop &loop, std::function<void()> done)
+            {
+        auto afs = std::make_shared<AsyncFileSystem>(fs, loop);
+        spawn(loop, afs->cp("/src", "/async"), [afs, done](std::exception_ptr e)
+              {
+            if (e)
+                std::rethrow_exception(e);
+            done(); }); });
+}
+
+/* -------------------- cache: bounded cache mode on a Zipfian workload -------------------- */
+
+// Read-through cache over `keys` 1 KiB objects with Zipf(0.99) popularity:
+// each request reads its key and writes it on a miss. For several limits
+// (as a share of all the objects), reports the hit rate next to that of an
+// exact LRU replaying the same requests, and the request rate.
+static void benchCache(const std::vector<std::string> &args)
+{
+    const int keys = args.empty() ? 100000 : std::stoi(args[0]);
+    const int requests = args.size() > 1 ? std::stoi(args[1]) : 2000000;
+    const size_t objectBytes = 1024;
+    const std::string object(objectBytes, 'c');
+
+    std::vector<double> cdf(keys);
+    double sum = 0;
+    for (int k = 0; k < keys; k++)
+        cdf[k] = sum += 1 / std::pow(k + 1, 0.99);
+    std::vector<int> trace(requests);
+    uint32_t rng = 2024;
+    for (int &key : trace)
+    {
+        rng = rng * 1664525 + 1013904223;
+        double u = (rng >> 8) / double(1 << 24) * sum;
+        key = int(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+        key = std::min(key, keys - 1);
+    }
+
+    for (double share : {0.01, 0.05, 0.1, 0.2})
+    {
+        const size_t capacity = std::max<size_t>(1, size_t(keys * share));
+
+        std::list<int> order; // most recent first
+        std::unordered_map<int, std::list<int>::iterator> where;
+        size_t lruHits = 0;
+        for (int key : trace)
+        {
+            auto it = where.find(key);
+            if (it != where.end())
+            {
+                lruHits++;
+                order.splice(order.begin(), order, it->second);
+                continue;
+            }
+            if (where.size() == capacity)
+            {
+                where.erase(order.back());
+                order.pop_back();
+            }
+            order.push_front(key);
+            where[key] = order.begin();
+        }
+
+        FileSystem fs;
+        fs.mkdir("/cache");
+        fs.setCacheLimit(capacity * objectBytes);
+        size_t hits = 0;
+        auto start = Clock::now();
+        for (int key : trace)
+        {
+            std::string path = "/cache/" + std::to_string(key);
+            try
+            {
+                fs.read(path);
+                hits++;
+            }
+            catch (const std::runtime_error &)
+            {
+                fs.write(path, object);
+            }
+        }
+        double ms = elapsedMs(start);
+        auto stats = fs.cacheStats();
+        std::cout << "limit " << share * 100 << "% (" << capacity << " objects): hit rate " << 100.0 * hits / requests
+                  << "%, exact LRU " << 100.0 * lruHits / requests << "%, " << requests / ms * 1e3 << " requests/s, "
+                  << stats.evictions << " evictions, " << stats.secondChances << " second chances\n";
+    }
+}
+
+/* -------------------- tar: archive import/export -------------------- */
+
+// Exports a generated tree to an in-memory tar stream and imports it back
+// with 1 and N workers, for both large and small files.
+static void benchTar(const std::vector<std::string> &)
+{
+    struct Shape
+    {
+        const char *label;
+        int dirs, files;
+        size_t size;
+    };
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (Shape shape : {Shape{"64 KiB files", 16, 200, 64 * 1024}, Shape{"1 KiB files ", 64, 2000, 1024}})
+    {
+        FileSystem src;
+        buildTree(src, "/src", shape.dirs, shape.files, shape.size);
+        double mb = shape.dirs * shape.files * (double)shape.size / (1 << 20);
+
+        std::stringstream archive;
+        auto start = Clock::now();
+        TarArchive::exportTar(src, "/src", archive);
+        double ms = elapsedMs(start);
+        std::cout << shape.label << " export:            " << mb / (ms / 1000) << " MB/s\n";
+
+        for (size_t workers : {(size_t)1, std::max<size_t>(cores, 4)})
+        {
+            FileSystem dst;
+            archive.clear();
+            archive.seekg(0);
+            TarOptions opts;
+            opts.workers = workers;
+            start = Clock::now();
+            TarArchive::importTar(dst, archive, "/", opts);
+            ms = elapsedMs(start);
+            std::cout << shape.label << " import " << workers << " worker(s): " << mb / (ms / 1000) << " MB/s, "
+                      << shape.dirs * shape.files / (ms / 1000) << " files/s\n";
+        }
+    }
+}
+
+/* -------------------- host: import/export to a host directory -------------------- */
+
+// host [files]: exports `files` 512 byte files (1000 per directory, 1M by
+// default) to a temporary host directory and imports them back.
+static void benchHost(const std::vector<std::string> &args)
+{
+    size_t count = args.empty() ? 1000000 : std::stoul(args[0]);
+    const size_t perDir = 1000;
+    FileSystem src;
+    src.mkdir("/host");
+    std::string payload(512, 'h');
+    for (size_t d = 0; d * perDir < count; d++)
+    {
+        std::string dir = "/host/d" + std::to_string(d);
+        src.mkdir(dir);
+        for (size_t f = 0; f < perDir && d * perDir + f < count; f++)
+            src.write(dir + "/f" + std::to_string(f), payload);
+    }
+
+    auto hostDir = std::filesystem::temp_directory_path() / ("inmemfs-bench-" + std::to_string(Clock::now().time_since_epoch().count()));
+    auto report = [](const char *label, const HostTransferStats &s)
+    {
+        std::cout << label << s.files << " files, " << s.dirs << " dirs in " << s.seconds << " s: "
+                  << (uint64_t)s.filesPerSec() << " files/s, " << s.mbPerSec() << " MB/s\n";
+    };
+    report("export: ", HostTransfer::exportToHost(src, "/host", hostDir.string()));
+
+    FileSystem dst;
+    report("import: ", HostTransfer::importFromHost(dst, hostDir.string(), "/host"));
+    std::filesystem::remove_all(hostDir);
+}
+
+/* -------------------- crc: checksum cost on the write path -------------------- */
+
+// Raw CRC32C speed (hardware vs. table) and the cost of maintaining extent
+// checksums while appending, compared to appending to a plain vector.
+static void benchCrc(const std::vector<std::string> &)
+{
+    std::vector<char> buf(64u << 20, 'c');
+    auto gbps = [](size_t bytes, double ms)
+    { return bytes / (ms / 1000) / (1 << 30); };
+
+    auto start = Clock::now();
+    volatile uint32_t sink = crc32cSoftware(0, buf.data(), buf.size());
+    std::cout << "crc32c table:    " << gbps(buf.size(), elapsedMs(start)) << " GB/s\n";
+#if defined(CRC32C_HAVE_SSE42)
+    if (crc32cHardwareAvailable())
+    {
+        start = Clock::now();
+        sink = crc32cHardware(0, buf.data(), buf.size());
+        std::cout << "crc32c sse4.2:   " << gbps(buf.size(), elapsedMs(start)) << " GB/s\n";
+    }
+#endif
+    (void)sink;
+
+    const size_t total = 256u << 20;
+    for (size_t chunk : {(size_t)64, (size_t)4096, (size_t)(1 << 20)})
+    {
+        std::vector<char> plain;
+        start = Clock::now();
+        for (size_t n = 0; n < total; n += chunk)
+            plain.insert(plain.end(), buf.data(), buf.data() + chunk);
+        double plainMs = elapsedMs(start);
+
+        FileNode file("f");
+        start = Clock::now();
+        for (size_t n = 0; n < total; n += chunk)
+            file.appendData(buf.data(), chunk);
+        double crcMs = elapsedMs(start);
+
+        std::cout << "append " << chunk << " B chunks: plain " << gbps(total, plainMs) << " GB/s, checksummed "
+                  << gbps(total, crcMs) << " GB/s (+" << (crcMs / plainMs - 1) * 100 << "%)\n";
+    }
+}
+
+/* -------------------- ipc: server load generator -------------------- */
+
+#if defined(__linux__)
+// ipc [socketPath]: drives a server (an in-process one unless a path is given)
+// with 50/50 reads and writes of 128 byte files, `depth` requests in flight per
+// connection, and reports throughput and per-request latency.
+static void benchIpc(const std::vector<std::string> &args)
+{
+    FileSystem fs;
+    std::unique_ptr<FileSystemServer> server;
+    std::string socketPath;
+    if (args.empty())
+    {
+        ServerOptions opts;
+        opts.socketPath = "/tmp/inmemfs-bench-" + std::to_string(getpid()) + ".sock";
+        server = std::make_unique<FileSystemServer>(fs, opts);
+        server->start();
+        socketPath = opts.socketPath;
+    }
+    else
+    {
+        socketPath = args[0];
+    }
+
+    {
+        FileSystemClient setup(socketPath);
+        try
+        {
+            setup.mkdir("/ipc");
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+        for (int i = 0; i < 1024; i++)
+            setup.write("/ipc/f" + std::to_string(i), std::string(128, 'x'));
+    }
+
+    const int depth = 32;
+    const auto duration = std::chrono::milliseconds(1000);
+    for (int conns : {1, 2, 4, 8, 16, 32})
+    {
+        std::atomic<uint64_t> ops{0};
+        std::vector<std::vector<double>> latencies(conns);
+        std::vector<std::thread> threads;
+        auto start = Clock::now();
+        for (int t = 0; t < conns; t++)
+        {
+            threads.emplace_back([&, t]
+                                 {
+                FileSystemClient client(socketPath);
+                std::string payload(128, 'y');
+                uint64_t seq = t * 7919;
+                std::deque<Clock::time_point> inFlight;
+                uint64_t done = 0;
+                while (Clock::now() - start < duration)
+                {
+                    while (inFlight.size() < (size_t)depth)
+                    {
+                        std::string path = "/ipc/f" + std::to_string(seq % 1024);
+                        if (seq++ & 1)
+                            client.send(Op::Read, 0, path);
+                        else
+                            client.send(Op::Write, 0, path, payload, true);
+                        inFlight.push_back(Clock::now());
+                    }
+                    client.flush();
+                    // reap half the window so there is always work queued at the server
+                    while (inFlight.size() > (size_t)depth / 2)
+                    {
+                        client.receive();
+                        latencies[t].push_back(std::chrono::duration<double, std::micro>(Clock::now() - inFlight.front()).count());
+                        inFlight.pop_front();
+                        done++;
+                    }
+                }
+                while (!inFlight.empty())
+                {
+                    client.receive();
+                    inFlight.pop_front();
+                }
+                ops += done; });
+        }
+        for (auto &t : threads)
+            t.join();
+        double secs = elapsedMs(start) / 1000.0;
+
+        std::vector<double> all;
+        for (auto &l : latencies)
+            all.insert(all.end(), l.begin(), l.end());
+        std::cout << conns << " conns: " << (uint64_t)(ops / secs) << " ops/s, p50 "
+                  << percentile(all, 0.5) << " us, p99 " << percentile(all, 0.99) << " us\n";
+    }
+}
+
+/* -------------------- shm: cross-process lookups -------------------- */
+
+// A forked reader process looks up and reads small files in a shared segment,
+// first alone and then while the parent keeps writing to the same directory.
+static void benchShm(const std::vector<std::string> &)
+{
+    const std::string name = "/inmemfs-bench-" + std::to_string(getpid());
+    ShmFileSystem::unlink(name);
+    auto fs = ShmFileSystem::create(name, 256u << 20);
+    fs.mkdir("/shm");
+    for (int i = 0; i < 1024; i++)
+        fs.write("/shm/f" + std::to_string(i), std::string(128, 'x'));
+
+    for (bool withWriter : {false, true})
+    {
+        int pipeFd[2];
+        if (pipe(pipeFd) < 0)
+            throw std::runtime_error("pipe failed");
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            auto reader = ShmFileSystem::open(name);
+            auto start = Clock::now();
+            uint64_t n = 0;
+            while (Clock::now() - start < std::chrono::milliseconds(1000))
+                for (int i = 0; i < 64; i++, n++)
+                    reader.read("/shm/f" + std::to_string(n % 1024));
+            double rate = n / (elapsedMs(start) / 1000.0);
+            if (::write(pipeFd[1], &rate, sizeof(rate)) < 0)
+                _exit(1);
+            _exit(0);
+        }
+        close(pipeFd[1]);
+        uint64_t writes = 0;
+        if (withWriter)
+        {
+            auto start = Clock::now();
+            while (Clock::now() - start < std::chrono::milliseconds(1000))
+                fs.write("/shm/f" + std::to_string(writes++ % 1024), std::string(128, 'y'));
+        }
+        double rate = 0;
+        if (::read(pipeFd[0], &rate, sizeof(rate)) < 0)
+            rate = 0;
+        close(pipeFd[0]);
+        waitpid(pid, nullptr, 0);
+        std::cout << (withWriter ? "with writer:    " : "readers only:   ") << (uint64_t)rate << " reads/s";
+        if (withWriter)
+            std::cout << ", " << writes << " writes/s";
+        std::cout << "\n";
+    }
+    ShmFileSystem::unlink(name);
+}
+
+/* -------------------- stream: cold sequential reads with and without advise -------------------- */
+
+// Streams one large file through a Reader in 1 MiB reads from a process that
+// has just mapped the segment, so every page starts unmapped in it. Each mode
+// runs in a fresh child: faulting pages in as they are read, and
+// advise(WillNeed) on the whole file first (counted in the time).
+static void benchStream(const std::vector<std::string> &args)
+{
+    const size_t fileMiB = args.empty() ? 1024 : std::stoul(args[0]);
+    const size_t bytes = fileMiB << 20;
+    const std::string name = "/inmemfs-stream-" + std::to_string(getpid());
+    ShmFileSystem::unlink(name);
+    {
+        auto fs = ShmFileSystem::create(name, bytes + (64u << 20));
+        fs.write("/image", std::string(bytes, 'i'));
+    }
+
+    const char *modes[] = {"page faults:      ", "advise WillNeed:  "};
+    for (int mode = 0; mode < 2; mode++)
+    {
+        int pipeFd[2];
+        if (pipe(pipeFd) < 0)
+            throw std::runtime_error("pipe failed");
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            auto fs = ShmFileSystem::open(name);
+            std::vector<char> buf(1u << 20);
+            auto start = Clock::now();
+            if (mode == 1)
+                fs.advise("/image", 0, bytes, ShmFileSystem::Advice::WillNeed);
+            auto reader = fs.openReader("/image");
+            size_t total = 0;
+            while (size_t got = reader.read(buf.data(), buf.size()))
+                total += got;
+            double rate = total / (elapsedMs(start) / 1000.0) / (1 << 20);
+            if (::write(pipeFd[1], &rate, sizeof(rate)) < 0)
+                _exit(1);
+            _exit(0);
+        }
+        close(pipeFd[1]);
+        double rate = 0;
+        if (::read(pipeFd[0], &rate, sizeof(rate)) < 0)
+            rate = 0;
+        close(pipeFd[0]);
+        waitpid(pid, nullptr, 0);
+        std::cout << modes[mode] << fileMiB << " MiB at " << rate << " MiB/s\n";
+    }
+    ShmFileSystem::unlink(name);
+}
+#endif
+
+/* -------------------- nodes: bytes per node -------------------- */
+
+// Heap growth per empty file and per empty directory, plus the node structs
+// themselves (the rest is the shared_ptr control block, the name and the
+// parent's hash table entry).
+static void benchNodes(const std::vector<std::string> &)
+{
+    std::cout << "sizeof INode " << sizeof(INode) << ", DirectoryNode " << sizeof(DirectoryNode) << ", FileNode "
+              << sizeof(FileNode) << "\n";
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    const int n = 200000;
+    for (bool dirs : {false, true})
+    {
+        size_t before = mallinfo2().uordblks;
+        {
+            FileSystem fs;
+            fs.mkdir("/n");
+            auto start = Clock::now();
+            for (int i = 0; i < n; i++)
+            {
+                std::string path = "/n/" + std::to_string(i);
+                if (dirs)
+                    fs.mkdir(path);
+                else
+                    fs.touch(path);
+            }
+            double ms = elapsedMs(start);
+            size_t after = mallinfo2().uordblks;
+            std::cout << (dirs ? "dirs:  " : "files: ") << (double)(after - before) / n << " heap bytes/node, "
+                      << ms * 1e6 / n << " ns/create\n";
+        }
+    }
+#endif
+}
+
+/* -------------------- depth: root lookups by path depth -------------------- */
+
+// Reads files spread over 1024 separate chains of directories, in scattered
+// order so the directories walked are rarely in the CPU cache, with the path
+// cache off (a lookup per component from the root) and on (one probe for the
+// file's directory), at growing depths
+static void benchDepth(const std::vector<std::string> &)
+{
+    const int chains = 1024, n = 200000;
+    for (size_t depth : {1, 2, 4, 8, 16, 32, 64})
+    {
+        FileSystem fs;
+        std::vector<std::string> paths;
+        for (int c = 0; c < chains; c++)
+        {
+            std::string path;
+            for (size_t i = 1; i < depth; i++)
+            {
+                path += (i == 1 ? "/c" + std::to_string(c) : "/d" + std::to_string(i));
+                fs.mkdir(path);
+            }
+            path += "/file" + std::to_string(c);
+            fs.write(path, std::string(64, 'd'));
+            paths.push_back(path);
+        }
+        std::cout << "depth " << depth << ":";
+        for (bool cached : {false, true})
+        {
+            fs.setPathCacheSize(cached ? PathCache::DefaultSlots : 0);
+            for (auto &p : paths)
+                fs.read(p);
+            auto start = Clock::now();
+            size_t bytes = 0;
+            for (int i = 0; i < n; i++)
+                bytes += fs.read(paths[(i * 7919u) % chains]).size();
+            double ms = elapsedMs(start);
+            std::cout << (cached ? "  cached " : "  walk ") << (ms * 1e6 / n) << " ns/read";
+            if (bytes != 64u * n)
+                std::cout << " (short read)";
+        }
+        std::cout << "\n";
+    }
+}
+
+/* -------------------- canon: path canonicalization -------------------- */
+
+// Canonical form by the obvious method: split, then apply "." and ".."
+static std::string referenceCanonical(const std::string &p)
+{
+    std::vector<std::string> stack;
+    for (auto &part : splitPath(p))
+    {
+        if (part == "..")
+        {
+            if (!stack.empty())
+                stack.pop_back();
+        }
+        else if (part != ".")
+            stack.push_back(part);
+    }
+    std::string out;
+    for (auto &part : stack)
+        out += "/" + part;
+    return out.empty() ? "/" : out;
+}
+
+// canon [cases]: checks canonicalPath and isCanonicalPath against the
+// reference on random paths over {'/', '.', 'a'} (a million by default, up
+// to 100 bytes so the SSE2 scan is covered), then times both on canonical and
+// non-canonical paths, short and long
+static void benchCanon(const std::vector<std::string> &args)
+{
+    const size_t cases = args.empty() ? 1000000 : std::stoul(args[0]);
+    uint32_t rng = 2024;
+    std::string scratch;
+    for (size_t i = 0; i < cases; i++)
+    {
+        rng = rng * 1664525 + 1013904223;
+        std::string p = "/";
+        for (size_t len = (rng >> 8) % 100; p.size() <= len;)
+        {
+            rng = rng * 1664525 + 1013904223;
+            p += "/.a"[(rng >> 16) % 3];
+        }
+        std::string want = referenceCanonical(p);
+        const std::string &got = canonicalPath(p, scratch);
+        if (got != want || isCanonicalPath(p) != (p == want) || !isCanonicalPath(got))
+        {
+            std::cout << "mismatch for \"" << p << "\": got \"" << got << "\", want \"" << want << "\"\n";
+            return;
+        }
+    }
+    std::cout << cases << " random paths match the reference\n";
+
+    std::string longPath;
+    for (int i = 0; i < 16; i++)
+        longPath += "/tenant-" + std::to_string(1000 + i) + "-data";
+    const std::pair<const char *, std::string> inputs[] = {
+        {"short canonical:    ", "/home/user/file.txt"},
+        {"short with ./..:    ", "/home/./user/../user//file.txt"},
+        {"256 B canonical:    ", longPath},
+        {"256 B with ./..:    ", "/./" + longPath.substr(1) + "/x/.."},
+    };
+    const int n = 2000000;
+    for (auto &[label, path] : inputs)
+    {
+        volatile size_t sink = 0;
+        auto start = Clock::now();
+        for (int i = 0; i < n; i++)
+            sink = sink + canonicalPath(path, scratch).size();
+        double ms = elapsedMs(start);
+        start = Clock::now();
+        for (int i = 0; i < n; i++)
+            sink = sink + referenceCanonical(path).size();
+        double refMs = elapsedMs(start);
+        std::cout << label << ms * 1e6 / n << " ns (split and rejoin " << refMs * 1e6 / n << " ns)\n";
+    }
+}
+
+/* -------------------- prefix: ordered listings from the path index -------------------- */
+
+// prefix [tenants]: /data/tenant-NNNN/2026/MM/DD/file-K for 100 tenants by
+// default (about a million paths). Times creates with and without the index,
+// then one tenant's full listing via listPrefix against a recursive find,
+// and longestPrefix against probing ancestors with ls.
+static void benchPrefix(const std::vector<std::string> &args)
+{
+    const int tenants = args.empty() ? 100 : std::stoi(args[0]);
+    auto pad = [](int v, int width)
+    {
+        std::string s = std::to_string(v);
+        return std::string(width - std::min<int>(width, (int)s.size()), '0') + s;
+    };
+    auto populate = [&](FileSystem &fs)
+    {
+        size_t paths = 0;
+        fs.mkdir("/data");
+        fs.mkdir("/data/2026");
+        for (int t = 0; t < tenants; t++)
+        {
+            std::string tenant = "/data/tenant-" + pad(t, 4);
+            fs.mkdir(tenant);
+            fs.mkdir(tenant + "/2026");
+            for (int m = 1; m <= 12; m++)
+            {
+                std::string month = tenant + "/2026/" + pad(m, 2);
+                fs.mkdir(month);
+                for (int d = 1; d <= 28; d++)
+                {
+                    std::string day = month + "/" + pad(d, 2);
+                    fs.mkdir(day);
+                    for (int k = 0; k < 28; k++)
+                        fs.touch(day + "/file-" + std::to_string(k));
+                    paths += 29;
+                }
+                paths++;
+            }
+            paths += 2;
+        }
+        return paths;
+    };
+
+    FileSystem plain, indexed;
+    indexed.setPathIndex(true);
+    auto start = Clock::now();
+    size_t paths = populate(plain);
+    double plainMs = elapsedMs(start);
+    start = Clock::now();
+    populate(indexed);
+    double indexedMs = elapsedMs(start);
+    std::cout << paths << " paths: create " << plainMs * 1e6 / paths << " ns/path, with index "
+              << indexedMs * 1e6 / paths << " ns/path\n";
+
+    std::string tenant = "/data/tenant-" + pad(tenants / 2, 4);
+    start = Clock::now();
+    auto walked = plain.find(tenant);
+    walked.erase(walked.begin()); // the tenant directory itself
+    double walkMs = elapsedMs(start);
+    start = Clock::now();
+    auto listed = indexed.listPrefix(tenant + "/");
+    double prefixMs = elapsedMs(start);
+    std::cout << "list " << tenant << "/ (" << listed.size() << " paths): find " << walkMs
+              << " ms, listPrefix " << prefixMs << " ms" << (listed == walked ? "" : " (MISMATCH)") << "\n";
+
+    start = Clock::now();
+    auto page = indexed.listRange(tenant + "/2026/06/15/", tenant + "/2026/06/16", 1000);
+    std::cout << "range of one day: " << page.size() << " paths in " << elapsedMs(start) << " ms\n";
+
+    const int n = 100000;
+    std::string missing = tenant + "/2026/06/15/file-3/x/y/z";
+    start = Clock::now();
+    std::string found;
+    for (int i = 0; i < n; i++)
+        found = indexed.longestPrefix(missing);
+    double lpmMs = elapsedMs(start);
+    start = Clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        std::string p = missing;
+        while (p.size() > 1)
+        {
+            try
+            {
+                plain.ls(p);
+                break;
+            }
+            catch (const std::runtime_error &)
+            {
+                p.resize(p.rfind('/'));
+            }
+        }
+    }
+    double probeMs = elapsedMs(start);
+    std::cout << "longest prefix of " << missing << " = " << found << ": " << lpmMs * 1e6 / n
+              << " ns, probing with ls " << probeMs * 1e6 / n << " ns\n";
+}
+
+/* -------------------- mkdirs: recursive creates on ingest -------------------- */
+
+// Ingests files eight directories deep: one mkdir per component (each a walk
+// from the root, ignoring "already exists") then write, against
+// write(path, data, true), which walks once. Then re-ensures every directory
+// with mkdir per component against mkdirs.
+static void benchMkdirs(const std::vector<std::string> &args)
+{
+    const int n = args.empty() ? 100000 : std::stoi(args[0]);
+    const int depth = 8;
+    std::vector<std::string> dirs(n);
+    for (int i = 0; i < n; i++)
+        for (int d = 0, v = i; d < depth; d++, v /= 4)
+            dirs[i] += "/d" + std::to_string(d) + "-" + std::to_string(v % 4 + (d == depth - 1 ? i : 0));
+    auto mkdirEach = [](FileSystem &fs, const std::string &dir)
+    {
+        for (size_t s = dir.find('/', 1);; s = dir.find('/', s + 1))
+        {
+            try
+            {
+                fs.mkdir(dir.substr(0, s));
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+            if (s == std::string::npos)
+                break;
+        }
+    };
+
+    FileSystem plain, single;
+    auto start = Clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        mkdirEach(plain, dirs[i]);
+        plain.write(dirs[i] + "/data", "payload");
+    }
+    double plainMs = elapsedMs(start);
+    start = Clock::now();
+    for (int i = 0; i < n; i++)
+        single.write(dirs[i] + "/data", "payload", true);
+    double singleMs = elapsedMs(start);
+    std::cout << n << " files at depth " << depth + 1 << ": mkdir per component " << plainMs * 1e6 / n
+              << " ns/file, write with create_parents " << singleMs * 1e6 / n << " ns/file\n";
+
+    start = Clock::now();
+    for (int i = 0; i < n; i++)
+        mkdirEach(plain, dirs[i]);
+    plainMs = elapsedMs(start);
+    start = Clock::now();
+    for (int i = 0; i < n; i++)
+        single.mkdirs(dirs[i]);
+    singleMs = elapsedMs(start);
+    std::cout << "existing directories: mkdir per component " << plainMs * 1e6 / n << " ns/path, mkdirs "
+              << singleMs * 1e6 / n << " ns/path\n";
+}
+
+/* -------------------- objects: object-store puts, listings and multipart -------------------- */
+
+// Puts keys three directories deep through the object store against creating
+// the same tree with mkdir per component and write, pages through a bucket
+// with and without a delimiter, and uploads one large object in parts from
+// several threads against a single put of the same bytes.
+static void benchObjects(const std::vector<std::string> &args)
+{
+    const int n = args.empty() ? 200000 : std::stoi(args[0]);
+    const size_t objectMiB = args.size() > 1 ? std::stoul(args[1]) : 256;
+    const std::string body(256, 'x');
+    auto keyOf = [](int i)
+    {
+        return "logs/host-" + std::to_string(i % 64) + "/day-" + std::to_string(i / 64 % 32) + "/obj-" +
+               std::to_string(i);
+    };
+
+    FileSystem plainFs;
+    auto start = Clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        std::string key = "/" + keyOf(i);
+        for (size_t s = key.find('/', 1); s != std::string::npos; s = key.find('/', s + 1))
+            try
+            {
+                plainFs.mkdir(key.substr(0, s));
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+        plainFs.write(key, body);
+    }
+    double plainMs = elapsedMs(start);
+    FileSystem fs;
+    ObjectStore store(fs);
+    start = Clock::now();
+    for (int i = 0; i < n; i++)
+        store.put(keyOf(i), body);
+    double putMs = elapsedMs(start);
+    std::cout << n << " puts: mkdir + write " << plainMs * 1e6 / n << " ns/object, put " << putMs * 1e6 / n
+              << " ns/object\n";
+
+    for (std::string delimiter : {"", "/"})
+    {
+        size_t keys = 0, prefixes = 0, pages = 0;
+        std::string token;
+        start = Clock::now();
+        do
+        {
+            auto page = store.list("logs/", delimiter, token);
+            keys += page.keys.size();
+            prefixes += page.commonPrefixes.size();
+            pages++;
+            token = page.continuation;
+        } while (!token.empty());
+        double listMs = elapsedMs(start);
+        std::cout << "list logs/ delimiter \"" << delimiter << "\": " << keys << " keys, " << prefixes << " prefixes in "
+                  << pages << " pages, " << listMs << " ms\n";
+    }
+
+    const size_t total = objectMiB << 20, partBytes = 8 << 20;
+    std::string bytes(total, 'y');
+    start = Clock::now();
+    store.put("big/single", bytes);
+    double singleMs = elapsedMs(start);
+    const size_t parts = (total + partBytes - 1) / partBytes;
+    const int threads = 4;
+    start = Clock::now();
+    uint64_t id = store.beginUpload("big/multipart", total, partBytes);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([&, t]
+                             {
+                                 for (size_t p = t; p < parts; p += threads)
+                                 {
+                                     size_t offset = p * partBytes;
+                                     store.uploadPart(id, p + 1, bytes.data() + offset,
+                                                      std::min(partBytes, total - offset));
+                                 } });
+    for (auto &w : workers)
+        w.join();
+    store.completeUpload(id);
+    double multipartMs = elapsedMs(start);
+    std::cout << objectMiB << " MiB object: put " << singleMs << " ms, " << parts << " parts on " << threads
+              << " threads " << multipartMs << " ms" << (store.get("big/multipart") == bytes ? "" : " (MISMATCH)")
+              << "\n";
+}
+
+/* -------------------- perm: permission-checked lookups -------------------- */
+
+// Reads a file 12 directories deep as root (no checks), as a user with a warm
+// prefix cache, and as a user whose Credentials are new every time (a check
+// per component).
+static void benchPerm(const std::vector<std::string> &)
+{
+    FileSystem fs;
+    std::string path;
+    for (int i = 0; i < 12; i++)
+    {
+        path += "/level" + std::to_string(i);
+        fs.mkdir(path);
+    }
+    path += "/file";
+    fs.write(path, std::string(64, 'p'));
+    fs.chown(path, 1000, 1000);
+
+    const int n = 200000;
+    Credentials user(1000, 1000);
+    auto run = [&](const char *label, auto &&read)
+    {
+        auto start = Clock::now();
+        size_t bytes = 0;
+        for (int i = 0; i < n; i++)
+            bytes += read().size();
+        double ms = elapsedMs(start);
+        std::cout << label << (ms * 1e6 / n) << " ns/read (" << bytes / n << " B)\n";
+    };
+    run("root:            ", [&]
+        { return fs.read(path); });
+    run("user, cached:    ", [&]
+        { return fs.read(user, path); });
+    run("user, uncached:  ", [&]
+        { return fs.read(Credentials(1000, 1000), path); });
+}
+
+/* -------------------- hugepages: TLB-sensitive random reads -------------------- */
+
+#if defined(__linux__)
+// AnonHugePages from /proc/self/smaps_rollup, in MiB
+static size_t anonHugeMiB()
+{
+    std::ifstream in("/proc/self/smaps_rollup");
+    for (std::string line; std::getline(in, line);)
+        if (line.rfind("AnonHugePages:", 0) == 0)
+            return std::stoul(line.substr(14)) / 1024;
+    return 0;
+}
+#endif
+
+// For each HugePages mode: dependent random 8 byte reads over 1 GiB of 4 MiB
+// file extents, then random lookups of 64 byte files among 300k, whose nodes
+// and directory tables come from the allocator's slabs
+static void benchHugePages(const std::vector<std::string> &)
+{
+    auto &alloc = BufferAllocator::instance();
+    const char *names[] = {"off", "transparent", "explicit"};
+    for (auto mode : {HugePages::Off, HugePages::Transparent, HugePages::Explicit})
+    {
+        alloc.setHugePages(mode);
+        double extentNs, lookupNs;
+        size_t hugeMiB = 0;
+        {
+            std::vector<FileData> extents(256);
+            for (auto &e : extents)
+            {
+                e.resize(4u << 20);
+                for (size_t i = 0; i < e.size(); i += 8)
+                {
+                    uint64_t v = i * 0x9E3779B97F4A7C15ull;
+                    memcpy(e.data() + i, &v, 8);
+                }
+            }
+            const size_t reads = 5000000;
+            uint64_t v = 1;
+            auto start = Clock::now();
+            for (size_t r = 0; r < reads; r++)
+            {
+                auto &e = extents[(v >> 32) % extents.size()];
+                uint64_t next;
+                memcpy(&next, e.data() + ((v % e.size()) & ~(size_t)7), 8);
+                v = next ^ (v * 6364136223846793005ull + r);
+            }
+            extentNs = elapsedMs(start) * 1e6 / reads + (v == 42 ? 1e-9 : 0);
+
+            FileSystem fs;
+            buildTree(fs, "/src", 300, 1000, 64);
+#if defined(__linux__)
+            hugeMiB = anonHugeMiB();
+#endif
+            const size_t lookups = 1000000;
+            uint32_t rng = 99;
+            size_t bytes = 0;
+            start = Clock::now();
+            for (size_t r = 0; r < lookups; r++)
+            {
+                rng = rng * 1664525 + 1013904223;
+                bytes += fs.du("/src/d" + std::to_string((rng >> 8) % 300) + "/f" + std::to_string(rng % 1000));
+            }
+            lookupNs = elapsedMs(start) * 1e6 / lookups + (bytes == 42 ? 1e-9 : 0);
+        }
+        auto stats = alloc.stats();
+        std::cout << names[(int)mode] << ": extent read " << extentNs << " ns, file lookup " << lookupNs
+                  << " ns; AnonHugePages " << hugeMiB << " MiB, explicit huge " << (stats.explicitHugeBytes >> 20)
+                  << " MiB\n";
+    }
+    alloc.setHugePages(HugePages::Transparent);
+}
+
+/* -------------------- numa: placement and cross-node reads -------------------- */
+
+// Read bandwidth for each (memory node, reading thread's node) pair, plus
+// interleaved memory; a single node machine only has the local row
+static void benchNuma(const std::vector<std::string> &)
+{
+    unsigned nodes = numaNodeCount();
+    std::cout << nodes << " NUMA node" << (nodes == 1 ? "" : "s") << ", " << BufferAllocator::instance().arenaCount()
+              << " allocator arena" << (nodes == 1 ? "" : "s") << "\n";
+    const int files = 64;
+    const std::string content(1 << 20, 'n');
+    FileSystem fs;
+    std::vector<std::pair<std::string, NumaPlacement>> placements;
+    for (unsigned m = 0; m < nodes; m++)
+        placements.push_back({"node " + std::to_string(m), NumaPlacement::bind(m)});
+    if (nodes > 1)
+        placements.push_back({"interleaved", NumaPlacement::interleave()});
+    for (size_t k = 0; k < placements.size(); k++)
+    {
+        std::string dir = "/p" + std::to_string(k);
+        fs.mkdir(dir);
+        fs.setPlacement(dir, placements[k].second);
+        for (int i = 0; i < files; i++)
+            fs.write(dir + "/f" + std::to_string(i), content);
+    }
+
+    for (size_t k = 0; k < placements.size(); k++)
+    {
+        std::cout << "memory on " << placements[k].first << ":";
+        for (unsigned t = 0; t < nodes; t++)
+        {
+            double mbPerSec = 0;
+            std::thread reader([&]
+                               {
+                pinThreadToNumaNode(t);
+                std::string dir = "/p" + std::to_string(k);
+                size_t bytes = 0;
+                auto start = Clock::now();
+                for (int round = 0; round < 4; round++)
+                    for (int i = 0; i < files; i++)
+                        bytes += fs.read(dir + "/f" + std::to_string(i)).size();
+                mbPerSec = bytes / (elapsedMs(start) / 1000) / (1 << 20); });
+            reader.join();
+            std::cout << "  thread on node " << t << " " << (size_t)mbPerSec << " MiB/s";
+        }
+        std::cout << "\n";
+    }
+}
+
+/* -------------------- shard: concurrent creates in one directory -------------------- */
+
+// Concurrent touch into one directory, single table vs sharded
+static void benchShard(const std::vector<std::string> &)
+{
+    const int total = 128 * 1024;
+    for (size_t shards : {1, 64})
+    {
+        for (int threads : {1, 2, 4, 8, 16, 32, 64})
+        {
+            FileSystem fs;
+            fs.mkdir("/hot");
+            fs.shardDirectory("/hot", shards);
+            std::vector<std::thread> workers;
+            auto start = Clock::now();
+            for (int t = 0; t < threads; t++)
+                workers.emplace_back([&, t]
+                                     {
+                    for (int i = t; i < total; i += threads)
+                        fs.touch("/hot/f" + std::to_string(i)); });
+            for (auto &w : workers)
+                w.join();
+            double ms = elapsedMs(start);
+            std::cout << (shards == 1 ? std::string("single table") : std::to_string(shards) + " shards") << ", "
+                      << threads << " threads: "
+                      << total / ms / 1000 << " M creates/s\n";
+        }
+    }
+}
+
+/* -------------------- growth: lookups while a directory grows -------------------- */
+
+// Lookup latency in a directory while another thread grows it
+static void benchGrowth(const std::vector<std::string> &)
+{
+    const int preload = 100000, grow = 1000000;
+    const char *names[] = {"single table", "64 shards", "lock-free"};
+    for (int layout = 0; layout < 3; layout++)
+    {
+        FileSystem fs;
+        fs.mkdir("/hot");
+        if (layout == 1)
+            fs.shardDirectory("/hot", 64);
+        else if (layout == 2)
+            fs.makeDirectoryLockFree("/hot");
+        for (int i = 0; i < preload; i++)
+            fs.touch("/hot/p" + std::to_string(i));
+
+        std::atomic<bool> growing{true};
+        std::vector<double> latencies;
+        std::thread reader([&]
+                           {
+            uint32_t rng = 7;
+            while (growing)
+            {
+                rng = rng * 1664525 + 1013904223;
+                std::string path = "/hot/p" + std::to_string(rng % preload);
+                auto start = Clock::now();
+                fs.du(path);
+                latencies.push_back(elapsedMs(start) * 1e6);
+            } });
+        auto start = Clock::now();
+        for (int i = 0; i < grow; i++)
+            fs.touch("/hot/g" + std::to_string(i));
+        double ms = elapsedMs(start);
+        growing = false;
+        reader.join();
+        std::cout << names[layout] << ": " << grow / ms / 1000 << " M creates/s; lookup p50 "
+                  << percentile(latencies, 0.5) << " ns, p99 " << percentile(latencies, 0.99) << " ns, p99.9 "
+                  << percentile(latencies, 0.999) << " ns, max " << percentile(latencies, 1) / 1e6 << " ms ("
+                  << latencies.size() << " lookups)\n";
+    }
+}
+
+/* -------------------- rehash: insert latency in a huge directory -------------------- */
+
+// rehash [entries]: per-insert latency while one directory grows to 10M
+// entries (by default), against the std::unordered_map directories used
+// before, which rehash all at once
+static void benchRehash(const std::vector<std::string> &args)
+{
+    const size_t n = args.empty() ? 10000000 : std::stoul(args[0]);
+    auto file = makeNode<FileNode>("f");
+    auto report = [&](const char *name, std::vector<double> &latencies, double ms)
+    {
+        std::cout << name << ": " << n / ms / 1000 << " M inserts/s; p50 " << percentile(latencies, 0.5)
+                  << " ns, p99.99 " << percentile(latencies, 0.9999) << " ns, max "
+                  << percentile(latencies, 1) / 1e6 << " ms\n";
+    };
+    std::vector<double> latencies(n);
+    // the directory goes first: freeing 10M map nodes leaves glibc a
+    // multi-second consolidation on its next large malloc
+    {
+        DirectoryNode dir("big");
+        auto start = Clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            std::string name = "f" + std::to_string(i);
+            auto t = Clock::now();
+            dir.addChild(name, file);
+            latencies[i] = elapsedMs(t) * 1e6;
+        }
+        report("DirectoryNode", latencies, elapsedMs(start));
+    }
+    {
+        std::unordered_map<std::string, std::shared_ptr<INode>> map;
+        auto start = Clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            std::string name = "f" + std::to_string(i);
+            auto t = Clock::now();
+            map[name] = file;
+            latencies[i] = elapsedMs(t) * 1e6;
+        }
+        report("unordered_map", latencies, elapsedMs(start));
+    }
+}
+
+/* -------------------- ttl: short-lived files expired by the timer wheel -------------------- */
+
+// Creates files with a short TTL as fast as one thread can while the expirer
+// removes them in the background, so only about ttl's worth of files are
+// alive at a time. Reports both rates and the create latency, which shows
+// whether expiry ever holds up the mutation path.
+static void benchTtl(const std::vector<std::string> &args)
+{
+    const int n = args.empty() ? 10000000 : std::stoi(args[0]);
+    const auto ttlMs = std::chrono::milliseconds(args.size() > 1 ? std::stoi(args[1]) : 50);
+    const int dirs = 64;
+
+    FileSystem fs;
+    for (int d = 0; d < dirs; d++)
+        fs.mkdir("/scratch" + std::to_string(d));
+    TtlExpirer ttl(fs);
+    ttl.start();
+    std::vector<double> latencies;
+    latencies.reserve(n / 16 + 1);
+    size_t maxLive = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        std::string path = "/scratch" + std::to_string(i % dirs) + "/f" + std::to_string(i);
+        auto t0 = Clock::now();
+        fs.touch(path);
+        ttl.expireAfter(path, ttlMs);
+        if (i % 16 == 0)
+            latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        if (i % 65536 == 0)
+            maxLive = std::max<size_t>(maxLive, i - ttl.stats().expired);
+    }
+    double createMs = elapsedMs(start);
+    while (ttl.stats().expired < (uint64_t)n)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    double totalMs = elapsedMs(start);
+    ttl.stop();
+    std::cout << n << " files, ttl " << ttlMs.count() << " ms: created at " << n / createMs * 1e3
+              << "/s, all expired after " << totalMs << " ms (" << n / totalMs * 1e3 << " expirations/s), at most "
+              << maxLive << " alive\n";
+    std::cout << "touch + expireAfter: p50 " << percentile(latencies, 0.5) << " us, p99 "
+              << percentile(latencies, 0.99) << " us, p99.99 " << percentile(latencies, 0.9999) << " us, max "
+              << percentile(latencies, 1.0) << " us\n";
+}
+
+/* -------------------- xattr: attribute-heavy metadata -------------------- */
+
+// Counts the heap bytes behind a map-based attribute set for comparison
+static size_t countedBytes = 0;
+
+template <typename T>
+struct CountingAllocator
+{
+    using value_type = T;
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U> &) {}
+    T *allocate(size_t n)
+    {
+        countedBytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, size_t n) { std::allocator<T>().deallocate(p, n); }
+    bool operator==(const CountingAllocator &) const { return true; }
+    bool operator!=(const CountingAllocator &) const { return false; }
+};
+
+// Tags 20000 files with content type, owner and etag, once as sidecar
+// "<file>.meta" files and once as xattrs, then looks every etag up again.
+static void benchXattr(const std::vector<std::string> &)
+{
+    const int dirs = 100, files = 200;
+    auto meta = [](int i, int j)
+    {
+        return std::vector<std::pair<std::string, std::string>>{
+            {"user.content-type", "application/octet-stream"},
+            {"user.owner", "svc-ingest-" + std::to_string(i % 7)},
+            {"user.etag", "\"" + std::to_string(i * 7919 + j * 104729) + "\""}};
+    };
+    auto path = [](const std::string &base, int i, int j)
+    { return base + "/d" + std::to_string(i) + "/f" + std::to_string(j); };
+
+    FileSystem sidecar, xattr;
+    buildTree(sidecar, "/src", dirs, files, 256);
+    buildTree(xattr, "/src", dirs, files, 256);
+
+    auto start = Clock::now();
+    for (int i = 0; i < dirs; i++)
+        for (int j = 0; j < files; j++)
+        {
+            std::string text;
+            for (auto &[k, v] : meta(i, j))
+                text += k + "=" + v + "\n";
+            sidecar.write(path("/src", i, j) + ".meta", text);
+        }
+    double sidecarWriteMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (int i = 0; i < dirs; i++)
+        for (int j = 0; j < files; j++)
+            for (auto &[k, v] : meta(i, j))
+                xattr.setxattr(path("/src", i, j), k, v);
+    double xattrWriteMs = elapsedMs(start);
+
+    size_t found = 0;
+    start = Clock::now();
+    for (int i = 0; i < dirs; i++)
+        for (int j = 0; j < files; j++)
+        {
+            std::string text = sidecar.read(path("/src", i, j) + ".meta");
+            size_t at = text.find("user.etag=");
+            found += at != std::string::npos;
+        }
+    double sidecarReadMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (int i = 0; i < dirs; i++)
+        for (int j = 0; j < files; j++)
+            found += !xattr.getxattr(path("/src", i, j), "user.etag").empty();
+    double xattrReadMs = elapsedMs(start);
+
+    size_t n = (size_t)dirs * files;
+    std::cout << "nodes: sidecar " << sidecar.find("/src").size() << ", xattr " << xattr.find("/src").size() << "\n";
+    std::cout << "tag " << n << " files: sidecar " << sidecarWriteMs << " ms, xattr " << xattrWriteMs << " ms\n";
+    std::cout << "look up etag: sidecar " << sidecarReadMs << " ms, xattr " << xattrReadMs << " ms (" << found
+              << " hits)\n";
+
+    // heap bytes per attribute set: packed block vs a map of strings
+    XattrSet packed;
+    using String = std::basic_string<char, std::char_traits<char>, CountingAllocator<char>>;
+    struct Hash
+    {
+        size_t operator()(const String &s) const { return std::hash<std::string_view>()(s); }
+    };
+    {
+        std::unordered_map<String, String, Hash, std::equal_to<String>,
+                           CountingAllocator<std::pair<const String, String>>>
+            map;
+        for (auto &[k, v] : meta(3, 5))
+        {
+            packed.set(k, v);
+            map.emplace(String(k.begin(), k.end()), String(v.begin(), v.end()));
+        }
+    }
+    std::cout << "bytes per 3-attribute set: packed " << XattrSet(packed).bytes() << ", unordered_map "
+              << countedBytes << ", none " << XattrSet().bytes() << " (+" << sizeof(XattrSet)
+              << " per node)\n";
+}
+
+/* -------------------- Main -------------------- */
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::function<void(const std::vector<std::string> &)>> benches = {
+        {"alloc", benchAlloc},
+        {"analytics", benchAnalytics},
+        {"async", benchAsync},
+        {"cache", benchCache},
+        {"canon", benchCanon},
+        {"crc", benchCrc},
+        {"depth", benchDepth},
+        {"growth", benchGrowth},
+        {"host", benchHost},
+        {"hugepages", benchHugePages},
+        {"mkdirs", benchMkdirs},
+        {"nodes", benchNodes},
+        {"numa", benchNuma},
+        {"objects", benchObjects},
+        {"perm", benchPerm},
+        {"prefix", benchPrefix},
+        {"rehash", benchRehash},
+        {"shard", benchShard},
+        {"tar", benchTar},
+        {"ttl", benchTtl},
+        {"xattr", benchXattr},
+#if defined(__linux__)
+        {"ipc", benchIpc},
+        {"shm", benchShm},
+        {"stream", benchStream},
+#endif
+    };
+
+    if (argc < 2 || !benches.count(argv[1]))
+    {
+        std::cout << "usage: " << argv[0] << " <benchmark> [args...]\navailable:";
+        for (auto &b : benches)
+            std::cout << " " << b.first;
+        std::cout << "\n";
+        return 1;
+    }
+    benches[argv[1]](std::vector<std::string>(argv + 2, argv + argc));
+    return 0;
+}
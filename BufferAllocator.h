@@ -0,0 +1,799 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "Numa.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define BUFFER_ALLOCATOR_HAVE_MMAP 1
+#endif
+
+/* -------------------- BufferAllocator -------------------- */
+
+// How slabs and mapped extents are backed
+enum class HugePages : uint8_t
+{
+    Off,         // normal pages (MADV_NOHUGEPAGE)
+    Transparent, // 2 MiB aligned and MADV_HUGEPAGE
+    Explicit     // MAP_HUGETLB from the reserved pool, else as Transparent
+};
+
+struct BufferAllocatorStats
+{
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t largeAllocations = 0; // above MaxSmall
+    int64_t requestedBytes = 0;    // live bytes asked for
+    int64_t blockBytes = 0;        // live bytes handed out, after rounding to size classes
+    size_t slabBytes = 0;          // reserved from the system for size classes
+    size_t mappedBytes = 0;        // live extents of MapThreshold bytes and up
+    size_t explicitHugeBytes = 0;  // slabs and extents currently on MAP_HUGETLB pages
+
+    // Share of handed-out small-block bytes lost to size-class rounding
+    double internalFragmentation() const
+    {
+        return blockBytes > 0 ? 1 - (double)std::min(requestedBytes, blockBytes) / blockBytes : 0;
+    }
+
+    // Share of slab memory not currently handed out (cached free blocks and
+    // slab tails)
+    double externalFragmentation() const
+    {
+        return slabBytes ? 1 - (double)std::max<int64_t>(blockBytes, 0) / slabBytes : 0;
+    }
+};
+
+// Size-class allocator for file contents and directory tables. Requests up to
+// MaxSmall bytes are rounded to one of 52 classes (multiples of 16 up to 64,
+// then four per power of two, so at most 25% rounding; every block is 16-byte
+// aligned) and served from a per-thread cache. The caches refill
+// from and spill to central per-class free lists in batches, so threads only
+// meet on a lock once per batch. Central lists carve new blocks out of 2 MiB
+// slabs. Requests of MapThreshold bytes and up are mapped on their own, rounded
+// to 2 MiB; the ones in between go to the system allocator. Slabs and mapped
+// extents are backed according to setHugePages (transparent huge pages by
+// default). Slab memory is kept for reuse and never returned.
+//
+// On a NUMA machine the central lists and slabs are split into arenas, one
+// per node plus one interleaved over all of them. Thread caches belong to the
+// arena of the thread's node; a PlacementScope sends a thread's allocations
+// to another arena (bypassing its cache) or binds/interleaves mapped extents,
+// and freed blocks go back to the arena they were carved from.
+class BufferAllocator
+{
+public:
+    static constexpr size_t MinBlock = 16;
+    static constexpr size_t MaxSmall = 256 * 1024;
+    static constexpr size_t ClassCount = 52;
+    static constexpr size_t SlabBytes = 2 * 1024 * 1024;
+    static constexpr size_t HugePageBytes = 2 * 1024 * 1024;
+    static constexpr size_t MapThreshold = 2 * 1024 * 1024;
+
+    static size_t classOf(size_t n)
+    {
+        if (n <= 64)
+            return n <= MinBlock ? 0 : (n - 1) / 16;
+        unsigned lg = floorLog2(n - 1); // n is in (2^lg, 2^(lg+1)], split in quarters
+        size_t quarter = (n - 1 - ((size_t)1 << lg)) >> (lg - 2);
+        return 4 + (lg - 6) * 4 + quarter;
+    }
+
+    static size_t classSize(size_t c)
+    {
+        if (c < 4)
+            return 16 * (c + 1);
+        unsigned lg = 6 + (unsigned)(c - 4) / 4;
+        return ((size_t)1 << lg) + ((c - 4) % 4 + 1) * ((size_t)1 << (lg - 2));
+    }
+
+    // Bytes actually available in an allocation of n bytes
+    static size_t usableSize(size_t n)
+    {
+        if (n >= MapThreshold)
+            return (n + HugePageBytes - 1) & ~(HugePageBytes - 1);
+        return n > MaxSmall ? n : classSize(classOf(n));
+    }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    // Blocks moved between a thread cache and the central list at a time
+    static size_t batchOf(size_t c) { return std::clamp<size_t>(64 * 1024 / classSize(c), 1, 32); }
+
+    static unsigned floorLog2(size_t v)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(v);
+#else
+        unsigned lg = 0;
+        while (v >>= 1)
+            lg++;
+        return lg;
+#endif
+    }
+
+    struct Counters
+    {
+        std::atomic<uint64_t> allocations{0}, frees{0}, large{0};
+        std::atomic<int64_t> requested{0}, blocks{0};
+
+        void fold(BufferAllocatorStats &s) const
+        {
+            s.allocations += allocations.load(std::memory_order_relaxed);
+            s.frees += frees.load(std::memory_order_relaxed);
+            s.largeAllocations += large.load(std::memory_order_relaxed);
+            s.requestedBytes += requested.load(std::memory_order_relaxed);
+            s.blockBytes += blocks.load(std::memory_order_relaxed);
+        }
+
+        // Thread caches are only written by their own thread, so a relaxed
+        // load+store is enough there
+        template <typename T>
+        static void add(std::atomic<T> &c, T v)
+        {
+            c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        }
+
+        // For the shared counters
+        void addShared(const BufferAllocatorStats &s)
+        {
+            allocations.fetch_add(s.allocations, std::memory_order_relaxed);
+            frees.fetch_add(s.frees, std::memory_order_relaxed);
+            large.fetch_add(s.largeAllocations, std::memory_order_relaxed);
+            requested.fetch_add(s.requestedBytes, std::memory_order_relaxed);
+            blocks.fetch_add(s.blockBytes, std::memory_order_relaxed);
+        }
+    };
+
+    struct ThreadCache
+    {
+        BufferAllocator &owner;
+        size_t home; // arena of the node this thread started on
+        FreeBlock *lists[ClassCount] = {};
+        uint32_t counts[ClassCount] = {};
+        Counters counters;
+
+        ThreadCache(BufferAllocator &o) : owner(o), home(o.arenaOfNode(currentNumaNode())) { owner.attach(this); }
+
+        ~ThreadCache()
+        {
+            owner.detach(this);
+            gone() = true;
+        }
+
+        // Set once this thread's cache has been destroyed; later frees on the
+        // thread (other thread_local destructors) go to the central lists
+        static bool &gone()
+        {
+            thread_local bool g = false;
+            return g;
+        }
+    };
+
+    struct alignas(64) CentralList
+    {
+        std::mutex m;
+        FreeBlock *head = nullptr;
+    };
+
+    // Central lists and slabs for one NUMA node, or for interleaved memory.
+    // A single-node machine has just one arena.
+    struct Arena
+    {
+        CentralList central[ClassCount];
+        NumaPlacement placement; // how the arena's slabs are placed
+        std::mutex slabMutex;
+        char *slabCursor = nullptr;
+        char *slabEnd = nullptr;
+    };
+
+    // Arena of each 2 MiB slab, for sending freed blocks home: two levels
+    // indexed by address / SlabBytes, only kept with more than one arena. A
+    // block the map does not cover goes to arena 0, which is harmless: any
+    // arena can reuse any block, it only costs locality.
+    static constexpr size_t PageMapLeafBits = 14;
+    static constexpr size_t PageMapRootSize = (size_t)1 << (48 - 21 - PageMapLeafBits);
+
+    std::vector<std::unique_ptr<Arena>> arenas;
+    std::unique_ptr<std::atomic<uint8_t *>[]> pageMap;
+    std::atomic<size_t> slabTotal{0};
+    std::atomic<size_t> mappedTotal{0};
+    std::atomic<size_t> explicitTotal{0};
+    std::atomic<HugePages> hugePages{HugePages::Transparent};
+    std::mutex explicitMutex;
+    std::vector<void *> explicitExtents; // mapped extents on MAP_HUGETLB pages
+
+    std::mutex cachesMutex;
+    std::vector<ThreadCache *> caches;
+    Counters retired; // exited threads and frees after a thread's cache is gone
+
+    BufferAllocator()
+    {
+        unsigned nodes = numaNodeCount();
+        if (nodes == 1)
+        {
+            arenas.push_back(std::make_unique<Arena>());
+            return;
+        }
+        // one arena per node, then one for interleaved memory
+        for (unsigned n = 0; n <= nodes; n++)
+        {
+            arenas.push_back(std::make_unique<Arena>());
+            arenas.back()->placement = n < nodes ? NumaPlacement::bind(n) : NumaPlacement::interleave();
+        }
+        pageMap.reset(new std::atomic<uint8_t *>[PageMapRootSize]());
+    }
+
+    static NumaPlacement &threadPlacement()
+    {
+        thread_local NumaPlacement p;
+        return p;
+    }
+
+    size_t arenaOfNode(unsigned node) const { return arenas.size() == 1 ? 0 : std::min<size_t>(node, arenas.size() - 2); }
+
+    // Arena new small blocks come from under the calling thread's placement
+    size_t arenaFor(const ThreadCache *tc) const
+    {
+        if (arenas.size() == 1)
+            return 0;
+        NumaPlacement p = threadPlacement();
+        if (p.isInterleave())
+            return arenas.size() - 1;
+        if (p.isBind())
+            return arenaOfNode(p.node());
+        return tc ? tc->home : arenaOfNode(currentNumaNode());
+    }
+
+    // Arena a small block was carved from
+    size_t arenaOf(const void *p) const
+    {
+        if (!pageMap)
+            return 0;
+        size_t page = (uintptr_t)p / SlabBytes, root = page >> PageMapLeafBits;
+        if (root >= PageMapRootSize)
+            return 0;
+        uint8_t *leaf = pageMap[root].load(std::memory_order_acquire);
+        return leaf ? leaf[page & (((size_t)1 << PageMapLeafBits) - 1)] : 0;
+    }
+
+    void recordSlab(const char *slab, size_t arena)
+    {
+        size_t page = (uintptr_t)slab / SlabBytes, root = page >> PageMapLeafBits;
+        if (!pageMap || root >= PageMapRootSize)
+            return;
+        uint8_t *leaf = pageMap[root].load(std::memory_order_acquire);
+        if (!leaf)
+        {
+            // leaves are never freed, like the slabs they describe
+            uint8_t *fresh = new uint8_t[(size_t)1 << PageMapLeafBits]();
+            if (pageMap[root].compare_exchange_strong(leaf, fresh, std::memory_order_acq_rel))
+                leaf = fresh;
+            else
+                delete[] fresh;
+        }
+        leaf[page & (((size_t)1 << PageMapLeafBits) - 1)] = (uint8_t)arena;
+    }
+
+    // Map len bytes (a multiple of HugePageBytes), aligned to a huge page,
+    // backed as the current HugePages mode asks and placed as `where` says
+    char *mapRegion(size_t len, bool &onExplicit, NumaPlacement where)
+    {
+        onExplicit = false;
+        char *region = nullptr;
+#if defined(BUFFER_ALLOCATOR_HAVE_MMAP)
+        HugePages mode = hugePages.load(std::memory_order_relaxed);
+#if defined(MAP_HUGETLB)
+        if (mode == HugePages::Explicit)
+        {
+            void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED)
+            {
+                explicitTotal += len;
+                onExplicit = true;
+                region = static_cast<char *>(p);
+            }
+            // else no reserved huge pages left; fall back to transparent ones
+        }
+#endif
+        if (!region)
+        {
+            // over-map so the region can be aligned to a huge page boundary
+            size_t span = len + HugePageBytes;
+            void *p = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+            uintptr_t start = (uintptr_t)p, aligned = (start + HugePageBytes - 1) & ~(uintptr_t)(HugePageBytes - 1);
+            if (aligned > start)
+                munmap(p, aligned - start);
+            if (aligned + len < start + span)
+                munmap((void *)(aligned + len), start + span - aligned - len);
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+            madvise((void *)aligned, len, mode == HugePages::Off ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+#endif
+            region = (char *)aligned;
+        }
+#else
+        region = static_cast<char *>(::operator new(len, std::align_val_t(HugePageBytes)));
+#endif
+        // nothing has touched the pages yet, so the policy decides where they go
+        if (where.isBind())
+            numaPlace(region, len, (int)where.node());
+        else if (where.isInterleave())
+            numaPlace(region, len, -1);
+        return region;
+    }
+
+    void *allocateLarge(size_t n)
+    {
+        if (n < MapThreshold)
+            return ::operator new(n);
+        if (n > SIZE_MAX - HugePageBytes)
+            throw std::bad_alloc(); // would wrap when rounded up
+        size_t len = usableSize(n);
+        bool onExplicit;
+        char *p = mapRegion(len, onExplicit, threadPlacement());
+        mappedTotal += len;
+        if (onExplicit)
+        {
+            std::lock_guard lock(explicitMutex);
+            explicitExtents.push_back(p);
+        }
+        return p;
+    }
+
+    void deallocateLarge(void *p, size_t n)
+    {
+        if (n < MapThreshold)
+        {
+            ::operator delete(p);
+            return;
+        }
+        size_t len = usableSize(n);
+        if (explicitTotal)
+        {
+            std::lock_guard lock(explicitMutex);
+            auto it = std::find(explicitExtents.begin(), explicitExtents.end(), p);
+            if (it != explicitExtents.end())
+            {
+                explicitExtents.erase(it);
+                explicitTotal -= len;
+            }
+        }
+#if defined(BUFFER_ALLOCATOR_HAVE_MMAP)
+        munmap(p, len);
+#else
+        ::operator delete(p, std::align_val_t(HugePageBytes));
+#endif
+        mappedTotal -= len;
+    }
+
+    // Carve up to `want` fresh blocks of class c from arena a into a list
+    FreeBlock *carve(size_t a, size_t c, size_t want, size_t &got)
+    {
+        Arena &arena = *arenas[a];
+        size_t size = classSize(c);
+        std::lock_guard lock(arena.slabMutex);
+        if ((size_t)(arena.slabEnd - arena.slabCursor) < size)
+        {
+            bool onExplicit;
+            arena.slabCursor = mapRegion(SlabBytes, onExplicit, arena.placement);
+            arena.slabEnd = arena.slabCursor + SlabBytes;
+            slabTotal += SlabBytes;
+            recordSlab(arena.slabCursor, a);
+        }
+        got = std::min(want, (size_t)(arena.slabEnd - arena.slabCursor) / size);
+        FreeBlock *head = nullptr;
+        for (size_t i = 0; i < got; i++)
+        {
+            auto b = reinterpret_cast<FreeBlock *>(arena.slabCursor + (got - 1 - i) * size);
+            b->next = head;
+            head = b;
+        }
+        arena.slabCursor += got * size;
+        return head;
+    }
+
+    void refill(ThreadCache &tc, size_t c)
+    {
+        CentralList &central = arenas[tc.home]->central[c];
+        size_t want = batchOf(c), got = 0;
+        FreeBlock *list = nullptr;
+        {
+            std::lock_guard lock(central.m);
+            while (got < want && central.head)
+            {
+                FreeBlock *b = central.head;
+                central.head = b->next;
+                b->next = list;
+                list = b;
+                got++;
+            }
+        }
+        if (!got)
+            list = carve(tc.home, c, want, got);
+        tc.lists[c] = list;
+        tc.counts[c] = (uint32_t)got;
+    }
+
+    // Give `n` blocks from the front of the thread's list back to the central list
+    void spill(ThreadCache &tc, size_t c, size_t n)
+    {
+        FreeBlock *first = tc.lists[c], *last = first;
+        for (size_t i = 1; i < n; i++)
+            last = last->next;
+        tc.lists[c] = last->next;
+        tc.counts[c] -= (uint32_t)n;
+        CentralList &central = arenas[tc.home]->central[c];
+        std::lock_guard lock(central.m);
+        last->next = central.head;
+        central.head = first;
+    }
+
+    // One block straight from an arena's central list, bypassing thread caches
+    FreeBlock *takeBlock(size_t a, size_t c)
+    {
+        {
+            CentralList &central = arenas[a]->central[c];
+            std::lock_guard lock(central.m);
+            if (FreeBlock *b = central.head)
+            {
+                central.head = b->next;
+                return b;
+            }
+        }
+        size_t got = 0;
+        return carve(a, c, 1, got);
+    }
+
+    void returnBlock(size_t a, size_t c, void *p)
+    {
+        auto b = static_cast<FreeBlock *>(p);
+        CentralList &central = arenas[a]->central[c];
+        std::lock_guard lock(central.m);
+        b->next = central.head;
+        central.head = b;
+    }
+
+    void attach(ThreadCache *tc)
+    {
+        std::lock_guard lock(cachesMutex);
+        caches.push_back(tc);
+    }
+
+    void detach(ThreadCache *tc)
+    {
+        for (size_t c = 0; c < ClassCount; c++)
+            if (tc->counts[c])
+                spill(*tc, c, tc->counts[c]);
+        std::lock_guard lock(cachesMutex);
+        caches.erase(std::find(caches.begin(), caches.end(), tc));
+        BufferAllocatorStats s;
+        tc->counters.fold(s);
+        retired.addShared(s);
+    }
+
+    ThreadCache *cache()
+    {
+        if (ThreadCache::gone())
+            return nullptr;
+        thread_local ThreadCache tc(*this);
+        return &tc;
+    }
+
+    // Paths for a thread whose cache has already been destroyed
+    void *allocateUncached(size_t n)
+    {
+        BufferAllocatorStats s;
+        s.allocations = 1;
+        s.requestedBytes = (int64_t)n;
+        if (n > MaxSmall)
+        {
+            s.largeAllocations = 1;
+            retired.addShared(s);
+            return allocateLarge(n);
+        }
+        size_t c = classOf(n);
+        s.blockBytes = (int64_t)classSize(c);
+        retired.addShared(s);
+        return takeBlock(arenaFor(nullptr), c);
+    }
+
+    void deallocateUncached(void *p, size_t n)
+    {
+        BufferAllocatorStats s;
+        s.frees = 1;
+        s.requestedBytes = -(int64_t)n;
+        if (n > MaxSmall)
+        {
+            retired.addShared(s);
+            deallocateLarge(p, n);
+            return;
+        }
+        size_t c = classOf(n);
+        s.blockBytes = -(int64_t)classSize(c);
+        retired.addShared(s);
+        returnBlock(arenaOf(p), c, p);
+    }
+
+public:
+    // The process-wide allocator. Never destroyed, so blocks freed during
+    // static destruction still have somewhere to go.
+    static BufferAllocator &instance()
+    {
+        static BufferAllocator *a = new BufferAllocator;
+        return *a;
+    }
+
+    // Sets where memory allocated on this thread goes until the scope ends.
+    // Placement is per allocation, not per object: a buffer that grows later
+    // follows whatever scope is active then.
+    class PlacementScope
+    {
+    private:
+        NumaPlacement saved;
+
+    public:
+        explicit PlacementScope(NumaPlacement p) : saved(threadPlacement()) { threadPlacement() = p; }
+        ~PlacementScope() { threadPlacement() = saved; }
+        PlacementScope(const PlacementScope &) = delete;
+        PlacementScope &operator=(const PlacementScope &) = delete;
+    };
+
+    static NumaPlacement placement() { return threadPlacement(); }
+
+    // One per NUMA node plus one for interleaved memory, or 1 on a single node
+    size_t arenaCount() const { return arenas.size(); }
+
+    // Backing for slabs and extents mapped from now on; existing memory keeps
+    // what it was given
+    void setHugePages(HugePages mode) { hugePages = mode; }
+    HugePages hugePagesMode() const { return hugePages; }
+
+    void *allocate(size_t n)
+    {
+        ThreadCache *cached = cache();
+        if (!cached)
+            return allocateUncached(n);
+        ThreadCache &tc = *cached;
+        Counters::add<uint64_t>(tc.counters.allocations, 1);
+        Counters::add<int64_t>(tc.counters.requested, (int64_t)n);
+        if (n > MaxSmall)
+        {
+            Counters::add<uint64_t>(tc.counters.large, 1);
+            return allocateLarge(n);
+        }
+        size_t c = classOf(n);
+        Counters::add<int64_t>(tc.counters.blocks, (int64_t)classSize(c));
+        size_t a = arenaFor(&tc);
+        if (a != tc.home)
+            return takeBlock(a, c); // placed elsewhere: uncached, locks per block
+        if (!tc.counts[c])
+            refill(tc, c);
+        FreeBlock *b = tc.lists[c];
+        tc.lists[c] = b->next;
+        tc.counts[c]--;
+        return b;
+    }
+
+    // allocate(n) filled with zeroes. Mapped extents already are, so large
+    // tables are not written up front: their pages fault in as they are used.
+    void *allocateZeroed(size_t n)
+    {
+        void *p = allocate(n);
+#if defined(BUFFER_ALLOCATOR_HAVE_MMAP)
+        if (n >= MapThreshold)
+            return p;
+#endif
+        memset(p, 0, n);
+        return p;
+    }
+
+    void deallocate(void *p, size_t n)
+    {
+        ThreadCache *cached = cache();
+        if (!cached)
+            return deallocateUncached(p, n);
+        ThreadCache &tc = *cached;
+        Counters::add<uint64_t>(tc.counters.frees, 1);
+        Counters::add<int64_t>(tc.counters.requested, -(int64_t)n);
+        if (n > MaxSmall)
+        {
+            deallocateLarge(p, n);
+            return;
+        }
+        size_t c = classOf(n);
+        Counters::add<int64_t>(tc.counters.blocks, -(int64_t)classSize(c));
+        size_t a = arenaOf(p);
+        if (a != tc.home)
+            return returnBlock(a, c, p);
+        auto b = static_cast<FreeBlock *>(p);
+        b->next = tc.lists[c];
+        tc.lists[c] = b;
+        if (++tc.counts[c] >= 2 * batchOf(c))
+            spill(tc, c, batchOf(c));
+    }
+
+    BufferAllocatorStats stats()
+    {
+        BufferAllocatorStats s;
+        std::lock_guard lock(cachesMutex);
+        retired.fold(s);
+        for (auto tc : caches)
+            tc->counters.fold(s);
+        s.slabBytes = slabTotal;
+        s.mappedBytes = mappedTotal;
+        s.explicitHugeBytes = explicitTotal;
+        return s;
+    }
+};
+
+// Standard allocator adapter over BufferAllocator::instance()
+template <typename T>
+struct PoolAllocator
+{
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        static_assert(alignof(T) <= BufferAllocator::MinBlock, "over-aligned types are not supported");
+        return static_cast<T *>(BufferAllocator::instance().allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n) { BufferAllocator::instance().deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &) const { return false; }
+};
+
+// Growable byte buffer on BufferAllocator. Stands in for std::vector<char> in
+// file contents: vector moves and copies elements one at a time when given a
+// custom allocator, where this uses memcpy, and capacity grows into the slack
+// of each size class before reallocating.
+class PooledBuffer
+{
+private:
+    char *p = nullptr;
+    size_t len = 0;
+    size_t asked = 0; // bytes requested for p; the block behind it may be larger
+
+    // The allocator is told the real size, so its requested-bytes statistic
+    // sees what size-class rounding costs, and the slack is used regardless
+    void reallocate(size_t n)
+    {
+        char *q = static_cast<char *>(BufferAllocator::instance().allocate(n));
+        if (len)
+            memcpy(q, p, len);
+        release();
+        p = q;
+        asked = n;
+    }
+
+    void release()
+    {
+        if (p)
+            BufferAllocator::instance().deallocate(p, asked);
+        p = nullptr;
+        asked = 0;
+    }
+
+    void grow(size_t n)
+    {
+        size_t cap = capacity();
+        if (n > cap)
+            reallocate(std::max(n, cap + cap / 2));
+    }
+
+public:
+    PooledBuffer() = default;
+    PooledBuffer(const char *data, size_t n) { assign(data, n); }
+    PooledBuffer(const PooledBuffer &o) { assign(o.p, o.len); }
+    PooledBuffer(PooledBuffer &&o) noexcept { swap(o); }
+    ~PooledBuffer() { release(); }
+
+    PooledBuffer &operator=(const PooledBuffer &o)
+    {
+        if (this != &o)
+            assign(o.p, o.len);
+        return *this;
+    }
+
+    PooledBuffer &operator=(PooledBuffer &&o) noexcept
+    {
+        PooledBuffer(std::move(o)).swap(*this);
+        return *this;
+    }
+
+    void swap(PooledBuffer &o) noexcept
+    {
+        std::swap(p, o.p);
+        std::swap(len, o.len);
+        std::swap(asked, o.asked);
+    }
+
+    // n zero bytes. Large buffers are fresh mappings and are not written
+    // here, so their pages only fault in as they are filled.
+    static PooledBuffer zeroed(size_t n)
+    {
+        PooledBuffer b;
+        if (n)
+        {
+            b.asked = n;
+            b.p = static_cast<char *>(BufferAllocator::instance().allocateZeroed(n));
+            b.len = n;
+        }
+        return b;
+    }
+
+    char *data() { return p; }
+    const char *data() const { return p; }
+    char *begin() { return p; }
+    char *end() { return p + len; }
+    const char *begin() const { return p; }
+    const char *end() const { return p + len; }
+    size_t size() const { return len; }
+    size_t capacity() const { return p ? BufferAllocator::usableSize(asked) : 0; }
+    bool empty() const { return len == 0; }
+
+    void reserve(size_t n)
+    {
+        if (n > capacity())
+            reallocate(n);
+    }
+
+    // New bytes are zeroed, as with vector
+    void resize(size_t n)
+    {
+        grow(n);
+        if (n > len)
+            memset(p + len, 0, n - len);
+        len = n;
+    }
+
+    // resize without zeroing the new bytes, for a caller about to fill them
+    void resizeForOverwrite(size_t n)
+    {
+        grow(n);
+        len = n;
+    }
+
+    void clear() { len = 0; }
+
+    void assign(const char *data, size_t n)
+    {
+        if (n > capacity())
+        {
+            len = 0;
+            reallocate(n);
+        }
+        if (n)
+            memmove(p, data, n);
+        len = n;
+    }
+
+    void append(const char *data, size_t n)
+    {
+        grow(len + n);
+        if (n)
+            memcpy(p + len, data, n);
+        len += n;
+    }
+};
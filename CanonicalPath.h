@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CANONICAL_PATH_HAVE_SSE2 1
+#endif
+
+/* -------------------- CanonicalPath -------------------- */
+
+// Absolute paths in canonical form: "/" or "/a/b" with no empty, "." or ".."
+// components and no trailing slash. ".." is resolved by name (there are no
+// symlinks) and stops at the root, as in POSIX. Most paths callers pass are
+// canonical already; isCanonicalPath recognises them with one scan over the
+// '/' bytes, sixteen at a time with SSE2, and canonicalPath then hands the
+// caller's string back without copying it.
+
+// Index of the first '/' in p at or after from, or p.size()
+inline size_t findSlash(std::string_view p, size_t from)
+{
+#if defined(CANONICAL_PATH_HAVE_SSE2)
+    const __m128i slash = _mm_set1_epi8('/');
+    for (; from + 16 <= p.size(); from += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p.data() + from));
+        if (unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, slash)))
+            return from + __builtin_ctz(mask);
+    }
+#endif
+    for (; from < p.size(); from++)
+        if (p[from] == '/')
+            return from;
+    return p.size();
+}
+
+// True for "/" and for absolute paths whose components are all proper names
+inline bool isCanonicalPath(std::string_view p)
+{
+    if (p.empty() || p[0] != '/')
+        return false;
+    if (p.size() == 1)
+        return true;
+    if (p.back() == '/')
+        return false;
+    // every component starts right after a slash, so it is enough to look
+    // at what follows each one: another slash, "." or ".."
+    for (size_t i = 0; i < p.size(); i = findSlash(p, i + 1))
+    {
+        char c = p[i + 1];
+        if (c == '/')
+            return false;
+        if (c == '.')
+        {
+            size_t rest = p.size() - (i + 2);
+            if (rest == 0 || p[i + 2] == '/')
+                return false;
+            if (p[i + 2] == '.' && (rest == 1 || p[i + 3] == '/'))
+                return false;
+        }
+    }
+    return true;
+}
+
+// path itself if it is canonical, otherwise its canonical form built in
+// scratch. Paths not starting with '/' are handed back untouched for the
+// caller to reject.
+inline const std::string &canonicalPath(const std::string &path, std::string &scratch)
+{
+    if (path.empty() || path[0] != '/' || isCanonicalPath(path))
+        return path;
+    std::string_view p(path);
+    scratch.clear();
+    scratch.reserve(p.size());
+    for (size_t i = 1; i <= p.size();)
+    {
+        size_t end = findSlash(p, i);
+        std::string_view part = p.substr(i, end - i);
+        if (part == "..")
+            scratch.resize(scratch.empty() ? 0 : scratch.rfind('/'));
+        else if (!part.empty() && part != ".")
+        {
+            scratch += '/';
+            scratch += part;
+        }
+        i = end + 1;
+    }
+    if (scratch.empty())
+        scratch = "/";
+    return scratch;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "FileSystem.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+/* -------------------- ChecksumScrubber -------------------- */
+
+struct ScrubOptions
+{
+    size_t bytesPerSecond = 64u << 20;          // verification rate limit
+    std::chrono::milliseconds passInterval{1000}; // pause between full passes
+    std::function<void(const std::string &path)> onCorruption;
+};
+
+struct ScrubStats
+{
+    uint64_t passes = 0;
+    uint64_t filesChecked = 0;
+    uint64_t bytesChecked = 0;
+    uint64_t corruptions = 0;
+};
+
+// Background thread that walks the tree over and over, re-verifying file
+// checksums one extent at a time under a read lock, throttled to
+// bytesPerSecond so it never competes noticeably with real traffic.
+class ChecksumScrubber
+{
+private:
+    FileSystem &fs;
+    ScrubOptions opts;
+    std::thread worker;
+    mutable std::mutex m;
+    std::condition_variable cv;
+    bool stopping = false;
+    ScrubStats totals;
+
+    using Clock = std::chrono::steady_clock;
+
+    // Sleep until deadline unless stop() is called first; false if stopping
+    bool waitUntil(Clock::time_point deadline)
+    {
+        std::unique_lock lock(m);
+        cv.wait_until(lock, deadline, [&]
+                      { return stopping; });
+        return !stopping;
+    }
+
+    // One walk over the tree; returns false if interrupted by stop()
+    bool pass(bool throttled, std::vector<std::string> *corrupted)
+    {
+        std::vector<std::pair<std::string, std::shared_ptr<INode>>> pending;
+        {
+            std::shared_lock lock(fs.treeMutex);
+            pending.push_back({"/", fs.root});
+        }
+        auto budget = Clock::now();
+        ScrubStats local;
+
+        while (!pending.empty())
+        {
+            auto [path, node] = std::move(pending.back());
+            pending.pop_back();
+
+            if (node->type == NodeType::Directory)
+            {
+                std::shared_lock lock(fs.treeMutex);
+                std::static_pointer_cast<DirectoryNode>(node)->children.forEach(
+                    [&](const std::string &name, const std::shared_ptr<INode> &child)
+                    { pending.push_back({(path == "/" ? "" : path) + "/" + name, child}); });
+                continue;
+            }
+
+            auto file = std::static_pointer_cast<FileNode>(node);
+            bool ok = true;
+            for (size_t offset = 0;; offset += FileNode::ChecksumExtent)
+            {
+                size_t checked;
+                {
+                    std::shared_lock lock(fs.treeMutex);
+                    if (offset >= file->size() && offset > 0)
+                        break;
+                    checked = std::min(FileNode::ChecksumExtent, file->size() - std::min(offset, file->size()));
+                    ok = file->verify(offset, FileNode::ChecksumExtent);
+                }
+                local.bytesChecked += checked;
+                if (!ok)
+                    break;
+                if (throttled && opts.bytesPerSecond)
+                {
+                    budget += std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>((double)checked / opts.bytesPerSecond));
+                    if (budget > Clock::now() && !waitUntil(budget))
+                        return false;
+                }
+            }
+            local.filesChecked++;
+            if (!ok)
+            {
+                local.corruptions++;
+                if (corrupted)
+                    corrupted->push_back(path);
+                if (opts.onCorruption)
+                    opts.onCorruption(path);
+            }
+        }
+
+        std::lock_guard lock(m);
+        totals.passes++;
+        totals.filesChecked += local.filesChecked;
+        totals.bytesChecked += local.bytesChecked;
+        totals.corruptions += local.corruptions;
+        return true;
+    }
+
+public:
+    ChecksumScrubber(FileSystem &_fs, ScrubOptions _opts = {}) : fs(_fs), opts(std::move(_opts)) {}
+
+    ~ChecksumScrubber() { stop(); }
+
+    void start()
+    {
+        if (worker.joinable())
+            return;
+        stopping = false;
+        worker = std::thread([this]
+                             {
+            while (pass(true, nullptr) && waitUntil(Clock::now() + opts.passInterval))
+            {
+            } });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // Verify everything now, unthrottled, on the calling thread
+    std::vector<std::string> scrubOnce()
+    {
+        std::vector<std::string> corrupted;
+        pass(false, &corrupted);
+        return corrupted;
+    }
+
+    ScrubStats stats() const
+    {
+        std::lock_guard lock(m);
+        return totals;
+    }
+};
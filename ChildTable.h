@@ -0,0 +1,875 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BufferAllocator.h"
+
+struct INode;
+
+/* -------------------- ChildTable -------------------- */
+
+// Chained hash map from names to nodes that grows a step at a time. Past one
+// entry per bucket it allocates a bucket array twice the size, and from then
+// on every insert or erase moves up to RehashStep buckets across; lookups
+// check both arrays until the move is done. No single operation rehashes the
+// whole table, so inserting into a directory with millions of entries costs
+// the same every time. Lookups do not write, so they can run side by side
+// under a shared lock.
+class ChildMap
+{
+public:
+    using Node = std::shared_ptr<INode>;
+
+    static constexpr size_t MinBuckets = 8;
+    static constexpr size_t RehashStep = 64;
+
+private:
+    struct Entry
+    {
+        Entry *next;
+        uint64_t hash;
+        std::string name;
+        Node node;
+    };
+
+    struct Buckets
+    {
+        Entry **head = nullptr;
+        size_t mask = 0;
+
+        size_t count() const { return head ? mask + 1 : 0; }
+    };
+
+    Buckets tables[2]; // [1] is only set while growing into it
+    size_t moved = 0;  // buckets of tables[0] already moved to tables[1]
+    size_t entries = 0;
+
+    static uint64_t hashOf(const std::string &n) { return std::hash<std::string>()(n); }
+
+    static Buckets allocateBuckets(size_t count)
+    {
+        auto head = static_cast<Entry **>(BufferAllocator::instance().allocateZeroed(count * sizeof(Entry *)));
+        return {head, count - 1};
+    }
+
+    static void freeBuckets(Buckets &b)
+    {
+        if (b.head)
+            BufferAllocator::instance().deallocate(b.head, b.count() * sizeof(Entry *));
+        b = {};
+    }
+
+    bool growing() const { return tables[1].head != nullptr; }
+
+    Entry *findEntry(const std::string &n, uint64_t h) const
+    {
+        for (const Buckets &b : tables)
+            if (b.head)
+                for (Entry *e = b.head[h & b.mask]; e; e = e->next)
+                    if (e->hash == h && e->name == n)
+                        return e;
+        return nullptr;
+    }
+
+    // Move up to RehashStep buckets into the new array
+    void step()
+    {
+        size_t end = std::min(moved + RehashStep, tables[0].count());
+        for (; moved < end; moved++)
+        {
+            Entry *e = tables[0].head[moved];
+            tables[0].head[moved] = nullptr;
+            while (e)
+            {
+                Entry *next = e->next;
+                Entry *&head = tables[1].head[e->hash & tables[1].mask];
+                e->next = head;
+                head = e;
+                e = next;
+            }
+        }
+        if (moved == tables[0].count())
+        {
+            freeBuckets(tables[0]);
+            tables[0] = tables[1];
+            tables[1] = {};
+            moved = 0;
+        }
+    }
+
+    void link(Entry *e)
+    {
+        if (!tables[0].head)
+            tables[0] = allocateBuckets(MinBuckets);
+        else if (!growing() && entries >= tables[0].count())
+            tables[1] = allocateBuckets(2 * tables[0].count());
+        Buckets &b = growing() ? tables[1] : tables[0];
+        Entry *&head = b.head[e->hash & b.mask];
+        e->next = head;
+        head = e;
+        entries++;
+    }
+
+public:
+    ChildMap() = default;
+    ChildMap(const ChildMap &) = delete;
+    ChildMap &operator=(const ChildMap &) = delete;
+
+    ChildMap(ChildMap &&o) noexcept { swap(o); }
+
+    ChildMap &operator=(ChildMap &&o) noexcept
+    {
+        ChildMap(std::move(o)).swap(*this);
+        return *this;
+    }
+
+    ~ChildMap() { clear(); }
+
+    void swap(ChildMap &o) noexcept
+    {
+        std::swap(tables, o.tables);
+        std::swap(moved, o.moved);
+        std::swap(entries, o.entries);
+    }
+
+    size_t size() const { return entries; }
+    bool empty() const { return entries == 0; }
+
+    Node find(const std::string &n) const
+    {
+        Entry *e = findEntry(n, hashOf(n));
+        return e ? e->node : nullptr;
+    }
+
+    // Insert unless the name is taken; false if it was
+    bool insert(const std::string &n, Node node)
+    {
+        if (growing())
+            step();
+        uint64_t h = hashOf(n);
+        if (findEntry(n, h))
+            return false;
+        Entry *e = PoolAllocator<Entry>().allocate(1);
+        link(new (e) Entry{nullptr, h, n, std::move(node)});
+        return true;
+    }
+
+    // Insert or replace
+    void assign(const std::string &n, Node node)
+    {
+        if (Entry *e = findEntry(n, hashOf(n)))
+            e->node = std::move(node);
+        else
+            insert(n, std::move(node));
+    }
+
+    bool erase(const std::string &n)
+    {
+        if (growing())
+            step();
+        uint64_t h = hashOf(n);
+        for (Buckets &b : tables)
+        {
+            if (!b.head)
+                continue;
+            for (Entry **link = &b.head[h & b.mask]; *link; link = &(*link)->next)
+            {
+                Entry *e = *link;
+                if (e->hash == h && e->name == n)
+                {
+                    *link = e->next;
+                    e->~Entry();
+                    PoolAllocator<Entry>().deallocate(e, 1);
+                    entries--;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void clear()
+    {
+        for (Buckets &b : tables)
+        {
+            for (size_t i = 0; i < b.count(); i++)
+                for (Entry *e = b.head[i], *next; e; e = next)
+                {
+                    next = e->next;
+                    e->~Entry();
+                    PoolAllocator<Entry>().deallocate(e, 1);
+                }
+            freeBuckets(b);
+        }
+        moved = 0;
+        entries = 0;
+    }
+
+    // f(name, node) for every entry, in no particular order
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        for (const Buckets &b : tables)
+            for (size_t i = 0; i < b.count(); i++)
+                for (Entry *e = b.head[i]; e; e = e->next)
+                    f(e->name, e->node);
+    }
+};
+
+// Lock-free open-addressing name -> node table, the third ChildTable layout.
+// find, insert and erase may all run at once from any number of threads;
+// lookups never wait. Slots are probed linearly and hold an Entry pointer or
+// one of a few sentinels. Past half full the table allocates one twice the
+// size and moves over incrementally: every insert first migrates one chunk
+// of slots, freezing each entry, copying it and marking its old slot moved.
+// Readers and writers follow the chain of tables, so nothing stops while a
+// huge directory grows. An erase that meets an entry in the middle of being
+// copied waits for that one slot.
+//
+// Erased entries and replaced tables are kept until reclaim(), which needs
+// exclusive access; a table that only grows holds at most its own size again
+// in old tables.
+class ConcurrentChildMap
+{
+public:
+    using Node = std::shared_ptr<INode>;
+
+private:
+    struct Entry
+    {
+        uint64_t hash;
+        std::string name;
+        Node node;
+    };
+
+    // Slot values: an Entry pointer (Frozen bit set while it is being copied)
+    // or a sentinel below SentinelLimit
+    static constexpr uintptr_t Empty = 0;
+    static constexpr uintptr_t Frozen = 1;
+    static constexpr uintptr_t Tombstone = 2;  // erased; probes continue
+    static constexpr uintptr_t Moved = 4;      // entry now lives in the next table; probes continue
+    static constexpr uintptr_t MovedEmpty = 6; // was empty when sealed; probes stop here
+    static constexpr uintptr_t SentinelLimit = 16;
+    static constexpr size_t MinCapacity = 16;
+    static constexpr size_t Chunk = 64; // slots migrated per insert
+
+    using Slot = std::atomic<uintptr_t>;
+
+    struct Table
+    {
+        size_t mask;
+        std::atomic<size_t> used{0};     // slots filled by inserts and copies
+        std::atomic<size_t> claimed{0};  // next slot to hand out for migration
+        std::atomic<size_t> migrated{0}; // slots done
+        std::atomic<Table *> next{nullptr};
+        Slot *slots;
+
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(PoolAllocator<Slot>().allocate(capacity))
+        {
+            for (size_t i = 0; i < capacity; i++)
+                new (&slots[i]) Slot(Empty);
+        }
+
+        ~Table() { PoolAllocator<Slot>().deallocate(slots, mask + 1); }
+
+        size_t capacity() const { return mask + 1; }
+    };
+
+    std::atomic<Table *> current;
+    std::atomic<size_t> live{0};
+    std::mutex retiredMutex;
+    std::vector<Table *> retiredTables;
+    std::vector<Entry *> retiredEntries;
+
+    static Entry *entryOf(uintptr_t x) { return reinterpret_cast<Entry *>(x & ~Frozen); }
+    static bool isEntry(uintptr_t x) { return x >= SentinelLimit; }
+
+    static uint64_t hashOf(const std::string &n) { return std::hash<std::string>()(n); }
+
+    static Entry *newEntry(uint64_t h, const std::string &n, Node node)
+    {
+        Entry *e = PoolAllocator<Entry>().allocate(1);
+        return new (e) Entry{h, n, std::move(node)};
+    }
+
+    static void deleteEntry(Entry *e)
+    {
+        e->~Entry();
+        PoolAllocator<Entry>().deallocate(e, 1);
+    }
+
+    static size_t roundUp(size_t n)
+    {
+        size_t c = MinCapacity;
+        while (c < n)
+            c <<= 1;
+        return c;
+    }
+
+    void retire(Entry *e)
+    {
+        std::lock_guard lock(retiredMutex);
+        retiredEntries.push_back(e);
+    }
+
+    // Only the current table grows; a table being moved into waits its turn
+    void startResize(Table *t)
+    {
+        if (t != current.load(std::memory_order_acquire) || t->next.load(std::memory_order_acquire))
+            return;
+        // room for the live entries plus what arrives while the move runs
+        auto next = new Table(std::max(roundUp(4 * live.load(std::memory_order_relaxed)), roundUp(t->capacity() / 4)));
+        Table *expected = nullptr;
+        if (!t->next.compare_exchange_strong(expected, next, std::memory_order_acq_rel))
+            delete next;
+    }
+
+    // Place a frozen entry in the next table; only the slot's migrator does this
+    static void copyInto(Table *t, Entry *e)
+    {
+        for (size_t i = e->hash & t->mask, probes = 0; probes <= t->mask; i = (i + 1) & t->mask, probes++)
+        {
+            uintptr_t expected = Empty;
+            if (t->slots[i].compare_exchange_strong(expected, (uintptr_t)e, std::memory_order_acq_rel))
+            {
+                t->used.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        // startResize sizes tables so this cannot happen
+        std::terminate();
+    }
+
+    void migrateSlot(Table *from, Table *to, size_t i)
+    {
+        Slot &slot = from->slots[i];
+        uintptr_t x = slot.load(std::memory_order_acquire);
+        for (;;)
+        {
+            if (x == Empty)
+            {
+                if (slot.compare_exchange_weak(x, MovedEmpty, std::memory_order_acq_rel))
+                    return;
+            }
+            else if (x == Tombstone)
+            {
+                if (slot.compare_exchange_weak(x, Moved, std::memory_order_acq_rel))
+                    return;
+            }
+            else if (x == Moved || x == MovedEmpty)
+                return; // sealed by an insert passing through
+            else if (!(x & Frozen))
+            {
+                if (slot.compare_exchange_weak(x, x | Frozen, std::memory_order_acq_rel))
+                    x |= Frozen;
+            }
+            else
+            {
+                copyInto(to, entryOf(x));
+                slot.store(Moved, std::memory_order_release);
+                return;
+            }
+        }
+    }
+
+    // Move one chunk of the current table into its successor, if a move is on
+    void helpMigrate()
+    {
+        Table *t = current.load(std::memory_order_acquire);
+        Table *next = t->next.load(std::memory_order_acquire);
+        if (!next)
+            return;
+        size_t from = t->claimed.fetch_add(Chunk, std::memory_order_relaxed);
+        if (from >= t->capacity())
+            return;
+        size_t to = std::min(from + Chunk, t->capacity());
+        for (size_t i = from; i < to; i++)
+            migrateSlot(t, next, i);
+        if (t->migrated.fetch_add(to - from, std::memory_order_acq_rel) + (to - from) == t->capacity())
+        {
+            current.store(next, std::memory_order_release);
+            std::lock_guard lock(retiredMutex);
+            retiredTables.push_back(t);
+        }
+    }
+
+    void finishMigration()
+    {
+        while (current.load(std::memory_order_acquire)->next.load(std::memory_order_acquire))
+            helpMigrate();
+    }
+
+public:
+    ConcurrentChildMap() : current(new Table(MinCapacity)) {}
+
+    ConcurrentChildMap(const ConcurrentChildMap &) = delete;
+    ConcurrentChildMap &operator=(const ConcurrentChildMap &) = delete;
+
+    ~ConcurrentChildMap()
+    {
+        reclaim();
+        Table *t = current.load();
+        for (size_t i = 0; i < t->capacity(); i++)
+            if (uintptr_t x = t->slots[i].load(); isEntry(x))
+                deleteEntry(entryOf(x));
+        delete t;
+    }
+
+    Node find(const std::string &n) const
+    {
+        uint64_t h = hashOf(n);
+        for (Table *t = current.load(std::memory_order_acquire); t; t = t->next.load(std::memory_order_acquire))
+        {
+            for (size_t i = h & t->mask, probes = 0; probes <= t->mask; i = (i + 1) & t->mask, probes++)
+            {
+                uintptr_t x = t->slots[i].load(std::memory_order_acquire);
+                if (x == Empty || x == MovedEmpty)
+                    break;
+                if (isEntry(x))
+                {
+                    Entry *e = entryOf(x);
+                    if (e->hash == h && e->name == n)
+                        return e->node;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    // Insert unless the name is taken; false if it was
+    bool insert(const std::string &n, Node node)
+    {
+        helpMigrate();
+        uint64_t h = hashOf(n);
+        Entry *e = newEntry(h, n, std::move(node));
+        for (;;)
+        {
+            for (Table *t = current.load(std::memory_order_acquire); t; t = t->next.load(std::memory_order_acquire))
+            {
+                for (size_t i = h & t->mask, probes = 0; probes <= t->mask; i = (i + 1) & t->mask, probes++)
+                {
+                    Slot &slot = t->slots[i];
+                    uintptr_t x = slot.load(std::memory_order_acquire);
+                    if (x == Empty && t->next.load(std::memory_order_acquire))
+                    {
+                        // a move is on: seal the end of the probe chain so a
+                        // racing insert of the same name cannot land behind it
+                        if (slot.compare_exchange_strong(x, MovedEmpty, std::memory_order_acq_rel))
+                            x = MovedEmpty;
+                    }
+                    else if (x == Empty)
+                    {
+                        bool target = t != current.load(std::memory_order_acquire);
+                        // a table still being moved into keeps half its slots
+                        // for the entries on their way
+                        if (target && t->used.load(std::memory_order_relaxed) >= t->capacity() / 2)
+                            break;
+                        if (slot.compare_exchange_strong(x, (uintptr_t)e, std::memory_order_acq_rel))
+                        {
+                            live.fetch_add(1, std::memory_order_relaxed);
+                            if (t->used.fetch_add(1, std::memory_order_relaxed) + 1 > t->capacity() / 2 && !target)
+                                startResize(t);
+                            return true;
+                        }
+                    }
+                    // a failed exchange left x holding what won the slot
+                    if (x == MovedEmpty)
+                        break;
+                    if (isEntry(x))
+                    {
+                        Entry *other = entryOf(x);
+                        if (other->hash == h && other->name == n)
+                        {
+                            deleteEntry(e);
+                            return false;
+                        }
+                    }
+                }
+            }
+            // no room on the chain yet: push the move along, or start one
+            Table *t = current.load(std::memory_order_acquire);
+            if (!t->next.load(std::memory_order_acquire))
+                startResize(t);
+            helpMigrate();
+            std::this_thread::yield();
+        }
+    }
+
+    bool erase(const std::string &n)
+    {
+        uint64_t h = hashOf(n);
+        for (Table *t = current.load(std::memory_order_acquire); t; t = t->next.load(std::memory_order_acquire))
+        {
+            for (size_t i = h & t->mask, probes = 0; probes <= t->mask; i = (i + 1) & t->mask, probes++)
+            {
+                Slot &slot = t->slots[i];
+                uintptr_t x = slot.load(std::memory_order_acquire);
+                if (x == Empty || x == MovedEmpty)
+                    break;
+                if (!isEntry(x) || entryOf(x)->hash != h || entryOf(x)->name != n)
+                    continue;
+                while (x & Frozen)
+                {
+                    // being copied to the next table; erase it there
+                    std::this_thread::yield();
+                    x = slot.load(std::memory_order_acquire);
+                }
+                if (x == Moved)
+                    break;
+                if (slot.compare_exchange_strong(x, Tombstone, std::memory_order_acq_rel))
+                {
+                    live.fetch_sub(1, std::memory_order_relaxed);
+                    retire(entryOf(x));
+                    return true;
+                }
+                // frozen in the meantime: look again
+                i = (i - 1) & t->mask;
+                probes--;
+            }
+        }
+        return false;
+    }
+
+    size_t size() const { return live.load(std::memory_order_relaxed); }
+
+    // f(name, node) for every entry. Entries inserted or erased meanwhile may
+    // or may not be visited; the rest are visited once.
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        std::vector<Entry *> entries;
+        auto collect = [&](Table *t)
+        {
+            for (size_t i = 0; i < t->capacity(); i++)
+                if (uintptr_t x = t->slots[i].load(std::memory_order_acquire); isEntry(x))
+                    entries.push_back(entryOf(x));
+        };
+        Table *first = current.load(std::memory_order_acquire);
+        collect(first);
+        if (Table *t = first->next.load(std::memory_order_acquire))
+        {
+            // entries being moved can show up in two tables
+            for (; t; t = t->next.load(std::memory_order_acquire))
+                collect(t);
+            std::sort(entries.begin(), entries.end());
+            entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+        }
+        for (Entry *e : entries)
+            f(e->name, e->node);
+    }
+
+    // Insert or replace. Needs exclusive access.
+    void assign(const std::string &n, Node node)
+    {
+        reclaim();
+        uint64_t h = hashOf(n);
+        Table *t = current.load();
+        for (size_t i = h & t->mask, probes = 0; probes <= t->mask; i = (i + 1) & t->mask, probes++)
+        {
+            uintptr_t x = t->slots[i].load();
+            if (x == Empty)
+                break;
+            if (isEntry(x) && entryOf(x)->hash == h && entryOf(x)->name == n)
+            {
+                entryOf(x)->node = std::move(node);
+                return;
+            }
+        }
+        insert(n, std::move(node));
+    }
+
+    // Finish any move and free erased entries and old tables. Needs
+    // exclusive access.
+    void reclaim()
+    {
+        finishMigration();
+        std::lock_guard lock(retiredMutex);
+        for (Entry *e : retiredEntries)
+            deleteEntry(e);
+        for (Table *t : retiredTables)
+            delete t;
+        retiredEntries.clear();
+        retiredTables.clear();
+    }
+};
+
+// Name -> node table behind DirectoryNode::children. A directory starts with
+// a single map guarded by the caller's tree lock. shard(n) splits it into n
+// sub-tables by name hash, each with its own lock and growing on its own, so
+// threads creating entries in one hot directory (under a shared tree lock)
+// only meet when their names land in the same shard. Every access to a
+// sharded table takes the shard's lock. makeLockFree() switches to a
+// ConcurrentChildMap instead, where no access takes a lock.
+class ChildTable
+{
+public:
+    using Node = std::shared_ptr<INode>;
+
+private:
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex m;
+        ChildMap map;
+    };
+
+    // Storage once the table is no longer a single map: either shards or a
+    // lock-free table. `live`, if given, counts the concurrent tables of an
+    // owner; it is decremented when the storage goes away, whether the table
+    // is unsharded or destroyed with its directory.
+    struct Shards
+    {
+        size_t mask = 0;
+        std::unique_ptr<Shard[]> shard;
+        std::unique_ptr<ConcurrentChildMap> lockFree;
+        std::shared_ptr<std::atomic<size_t>> live;
+
+        ~Shards()
+        {
+            if (live)
+                live->fetch_sub(1, std::memory_order_relaxed);
+        }
+    };
+
+    ChildMap single;
+    std::unique_ptr<Shards> shards;
+
+    ConcurrentChildMap *lockFree() const { return shards ? shards->lockFree.get() : nullptr; }
+
+    // Take all entries out, leaving the table empty and unsharded
+    ChildMap drain()
+    {
+        ChildMap all;
+        forEach([&](const std::string &name, const Node &node)
+                { all.insert(name, node); });
+        single.clear();
+        shards.reset();
+        return all;
+    }
+
+    void track(std::shared_ptr<std::atomic<size_t>> live)
+    {
+        if (live)
+            live->fetch_add(1, std::memory_order_relaxed);
+        shards->live = std::move(live);
+    }
+
+    Shard &shardOf(const std::string &n) const
+    {
+        // the maps index buckets by the same hash; mix it so shard and bucket
+        // choice are independent
+        uint64_t h = std::hash<std::string>()(n);
+        return shards->shard[((h ^ (h >> 31)) * 0x9E3779B97F4A7C15ull >> 32) & shards->mask];
+    }
+
+public:
+    ChildTable() = default;
+    ChildTable(const ChildTable &) = delete;
+    ChildTable &operator=(const ChildTable &) = delete;
+
+    // True when inserts may run side by side (sharded or lock-free)
+    bool concurrent() const { return shards != nullptr; }
+    size_t shardCount() const { return shards && !shards->lockFree ? shards->mask + 1 : 1; }
+
+    // Redistribute the entries over n shards (rounded up to a power of two;
+    // 1 goes back to a single map). Needs exclusive access to the table.
+    // live is counted up while the table stays sharded (see Shards).
+    void shard(size_t n, std::shared_ptr<std::atomic<size_t>> live = nullptr)
+    {
+        size_t count = 1;
+        while (count < std::min<size_t>(n, 1024))
+            count <<= 1;
+        ChildMap all = drain();
+        if (count > 1)
+        {
+            shards.reset(new Shards{count - 1, std::unique_ptr<Shard[]>(new Shard[count]), nullptr, nullptr});
+            track(std::move(live));
+            all.forEach([&](const std::string &name, const Node &node)
+                        { shardOf(name).map.insert(name, node); });
+        }
+        else
+            single = std::move(all);
+    }
+
+    // Move the entries into a ConcurrentChildMap. Needs exclusive access.
+    void makeLockFree(std::shared_ptr<std::atomic<size_t>> live = nullptr)
+    {
+        ChildMap all = drain();
+        shards.reset(new Shards{0, nullptr, std::make_unique<ConcurrentChildMap>(), nullptr});
+        track(std::move(live));
+        all.forEach([&](const std::string &name, const Node &node)
+                    { shards->lockFree->insert(name, node); });
+    }
+
+    // Free what a lock-free table has kept for readers that might still be
+    // looking. Needs exclusive access.
+    void reclaim()
+    {
+        if (auto *map = lockFree())
+            map->reclaim();
+    }
+
+    Node find(const std::string &n) const
+    {
+        if (!shards)
+            return single.find(n);
+        if (auto *map = lockFree())
+            return map->find(n);
+        Shard &s = shardOf(n);
+        std::shared_lock lock(s.m);
+        return s.map.find(n);
+    }
+
+    bool contains(const std::string &n) const { return find(n) != nullptr; }
+
+    // Insert or replace
+    void assign(const std::string &n, Node node)
+    {
+        if (!shards)
+            return single.assign(n, std::move(node));
+        if (auto *map = lockFree())
+            return map->assign(n, std::move(node));
+        Shard &s = shardOf(n);
+        std::unique_lock lock(s.m);
+        s.map.assign(n, std::move(node));
+    }
+
+    // Insert unless the name is taken; false if it was
+    bool insert(const std::string &n, Node node)
+    {
+        if (!shards)
+            return single.insert(n, std::move(node));
+        if (auto *map = lockFree())
+            return map->insert(n, std::move(node));
+        Shard &s = shardOf(n);
+        std::unique_lock lock(s.m);
+        return s.map.insert(n, std::move(node));
+    }
+
+    bool erase(const std::string &n)
+    {
+        if (!shards)
+            return single.erase(n);
+        if (auto *map = lockFree())
+            return map->erase(n);
+        Shard &s = shardOf(n);
+        std::unique_lock lock(s.m);
+        return s.map.erase(n);
+    }
+
+    size_t size() const
+    {
+        if (!shards)
+            return single.size();
+        if (auto *map = lockFree())
+            return map->size();
+        size_t total = 0;
+        for (size_t i = 0; i <= shards->mask; i++)
+        {
+            std::shared_lock lock(shards->shard[i].m);
+            total += shards->shard[i].map.size();
+        }
+        return total;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    void clear()
+    {
+        if (!shards)
+            return single.clear();
+        if (lockFree())
+        {
+            shards->lockFree = std::make_unique<ConcurrentChildMap>();
+            return;
+        }
+        for (size_t i = 0; i <= shards->mask; i++)
+        {
+            std::unique_lock lock(shards->shard[i].m);
+            shards->shard[i].map.clear();
+        }
+    }
+
+    // f(name, node) for every entry, in no particular order. A sharded table
+    // holds each shard's lock shared while visiting it, so f must not add to
+    // or remove from this table.
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        if (!shards)
+        {
+            return single.forEach(f);
+        }
+        if (auto *map = lockFree())
+            return map->forEach(f);
+        for (size_t i = 0; i <= shards->mask; i++)
+        {
+            std::shared_lock lock(shards->shard[i].m);
+            shards->shard[i].map.forEach(f);
+        }
+    }
+
+    // Names in order: shards are sorted one by one and merged
+    std::vector<std::string> sortedNames() const
+    {
+        if (auto *map = lockFree())
+        {
+            std::vector<std::string> out;
+            out.reserve(map->size());
+            map->forEach([&](const std::string &name, const Node &)
+                         { out.push_back(name); });
+            std::sort(out.begin(), out.end());
+            return out;
+        }
+        std::vector<std::vector<std::string>> runs;
+        size_t total = 0;
+        for (size_t i = 0; i < shardCount(); i++)
+        {
+            auto &run = runs.emplace_back();
+            auto take = [&](const ChildMap &map)
+            {
+                run.reserve(map.size());
+                map.forEach([&](const std::string &name, const Node &)
+                            { run.push_back(name); });
+            };
+            if (!shards)
+                take(single);
+            else
+            {
+                std::shared_lock lock(shards->shard[i].m);
+                take(shards->shard[i].map);
+            }
+            std::sort(run.begin(), run.end());
+            total += run.size();
+        }
+        if (runs.size() == 1)
+            return std::move(runs[0]);
+
+        std::vector<std::string> out;
+        out.reserve(total);
+        using Cursor = std::pair<size_t, size_t>; // (run, position)
+        auto later = [&](const Cursor &a, const Cursor &b)
+        { return runs[a.first][a.second] > runs[b.first][b.second]; };
+        std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heads(later);
+        for (size_t r = 0; r < runs.size(); r++)
+            if (!runs[r].empty())
+                heads.push({r, 0});
+        while (!heads.empty())
+        {
+            auto [r, k] = heads.top();
+            heads.pop();
+            out.push_back(std::move(runs[r][k]));
+            if (k + 1 < runs[r].size())
+                heads.push({r, k + 1});
+        }
+        return out;
+    }
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+/* -------------------- CRC32C (Castagnoli) -------------------- */
+
+// crc32c(crc, data, n) continues a checksum, so crc32c(crc32c(0, a), b) is the
+// checksum of a followed by b. Uses the SSE4.2 crc32 instruction when the CPU
+// has it and a slicing-by-8 table otherwise.
+
+struct Crc32cTables
+{
+    uint32_t t[8][256];
+
+    Crc32cTables()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c >> 1) ^ (0x82f63b78 & (0u - (c & 1)));
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++)
+            for (int s = 1; s < 8; s++)
+                t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+    }
+};
+
+inline uint32_t crc32cSoftware(uint32_t crc, const void *data, size_t n)
+{
+    static const Crc32cTables tables;
+    auto &t = tables.t;
+    auto p = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    while (n >= 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v ^= crc;
+        crc = t[7][v & 0xff] ^ t[6][(v >> 8) & 0xff] ^ t[5][(v >> 16) & 0xff] ^ t[4][(v >> 24) & 0xff] ^
+              t[3][(v >> 32) & 0xff] ^ t[2][(v >> 40) & 0xff] ^ t[1][(v >> 48) & 0xff] ^ t[0][v >> 56];
+        p += 8;
+        n -= 8;
+    }
+    while (n--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    return ~crc;
+}
+
+#if defined(CRC32C_HAVE_SSE42)
+__attribute__((target("sse4.2"))) inline uint32_t crc32cHardware(uint32_t crc, const void *data, size_t n)
+{
+    auto p = static_cast<const uint8_t *>(data);
+    uint64_t c = ~crc;
+    while (n >= 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        n -= 8;
+    }
+    uint32_t c32 = (uint32_t)c;
+    while (n--)
+        c32 = _mm_crc32_u8(c32, *p++);
+    return ~c32;
+}
+#endif
+
+inline bool crc32cHardwareAvailable()
+{
+#if defined(CRC32C_HAVE_SSE42)
+    static const bool available = __builtin_cpu_supports("sse4.2");
+    return available;
+#else
+    return false;
+#endif
+}
+
+inline uint32_t crc32c(uint32_t crc, const void *data, size_t n)
+{
+#if defined(CRC32C_HAVE_SSE42)
+    if (crc32cHardwareAvailable())
+        return crc32cHardware(crc, data, n);
+#endif
+    return crc32cSoftware(crc, data, n);
+}
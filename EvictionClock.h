@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct FileNode;
+
+/* -------------------- EvictionClock -------------------- */
+
+struct CacheStats
+{
+    size_t limit = 0; // bytes; 0 when cache mode is off
+    size_t bytes = 0; // file contents currently charged
+    size_t files = 0;
+    uint64_t evictions = 0;
+    uint64_t evictedBytes = 0;
+    uint64_t secondChances = 0; // recently read files the hand passed over
+    uint64_t pinnedSkips = 0;   // pinned (or just written) files it passed over
+};
+
+// The files of a FileSystem in cache mode, in a CLOCK ring for picking what
+// to evict. Each file has a slot holding its path and the bytes it was
+// charged. Reads only set a flag in the file itself, so they take no lock
+// and never come here. The hand sweeps the ring, clearing those flags, and
+// stops at the first file that was not read since its last pass: a
+// second-chance approximation of LRU at O(1) amortized per eviction.
+//
+// Not thread safe; the owner serialises access.
+class EvictionClock
+{
+public:
+    static constexpr uint32_t NoSlot = UINT32_MAX;
+
+    struct Entry
+    {
+        FileNode *file = nullptr; // null for a free slot
+        std::string path;
+        size_t bytes = 0;
+    };
+
+private:
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeSlots;
+    size_t hand = 0;
+    size_t live = 0;
+    size_t used = 0;
+
+public:
+    size_t bytes() const { return used; }
+    size_t files() const { return live; }
+
+    uint32_t add(FileNode *file, std::string path, size_t bytes)
+    {
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            slot = (uint32_t)entries.size();
+            entries.emplace_back();
+        }
+        entries[slot] = Entry{file, std::move(path), bytes};
+        live++;
+        used += bytes;
+        return slot;
+    }
+
+    // Forget file, if slot is still its own
+    void remove(uint32_t slot, const FileNode *file)
+    {
+        if (slot >= entries.size() || entries[slot].file != file)
+            return;
+        used -= entries[slot].bytes;
+        entries[slot] = Entry{};
+        freeSlots.push_back(slot);
+        live--;
+    }
+
+    void resize(uint32_t slot, size_t bytes)
+    {
+        used += bytes - entries[slot].bytes;
+        entries[slot].bytes = bytes;
+    }
+
+    const Entry &at(uint32_t slot) const { return entries[slot]; }
+
+    // Move the hand to the next file to evict and return its slot. spare(file)
+    // is asked about each file passed and returns true to keep it this time
+    // round. NoSlot if two full turns find nothing. The entry stays until
+    // remove().
+    template <typename F>
+    uint32_t next(F &&spare)
+    {
+        for (size_t seen = 0, n = entries.size(); seen < 2 * n; seen++)
+        {
+            size_t slot = hand;
+            hand = hand + 1 == n ? 0 : hand + 1;
+            if (entries[slot].file && !spare(entries[slot].file))
+                return (uint32_t)slot;
+        }
+        return NoSlot;
+    }
+};
@@ -0,0 +1,1769 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <ctime>
+#include <atomic>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+#include "BufferAllocator.h"
+#include "CanonicalPath.h"
+#include "ChildTable.h"
+#include "Crc32c.h"
+#include "EvictionClock.h"
+#include "PathCache.h"
+#include "PathIndex.h"
+
+/* ----------------------- Basic Helpers and Types ----------------------- */
+enum class NodeType : uint8_t
+{
+    Directory,
+    File
+};
+
+struct Permissions
+{
+    // rws bits per owner/group.others represented by ints 0-7
+    int owner = 6;  // rw- by default (4+2)
+    int group = 4;  // r--
+    int others = 4; // r--
+};
+
+// Access bits requested by an operation, as in Permissions
+constexpr unsigned MayRead = 4;
+constexpr unsigned MayWrite = 2;
+constexpr unsigned MayExec = 1; // search, for directories
+
+struct PermissionDenied : std::runtime_error
+{
+    PermissionDenied(const std::string &path) : std::runtime_error("Permission denied: " + path) {}
+};
+
+struct DirectoryNode;
+
+// Who an operation runs as; uid 0 bypasses all checks. A Credentials object
+// also remembers the directories it has already been allowed to search
+// through, so repeated lookups under the same prefix skip the per-component
+// checks. Keep one per caller; copies start with an empty cache.
+struct Credentials
+{
+    uint32_t uid = 0;
+    uint32_t gid = 0;
+    std::vector<uint32_t> groups; // supplementary groups
+
+    Credentials() = default;
+    Credentials(uint32_t _uid, uint32_t _gid, std::vector<uint32_t> _groups = {})
+        : uid(_uid), gid(_gid), groups(std::move(_groups)) {}
+    Credentials(const Credentials &o) : uid(o.uid), gid(o.gid), groups(o.groups) {}
+
+    Credentials &operator=(const Credentials &o)
+    {
+        if (this != &o)
+        {
+            std::lock_guard lock(cacheMutex);
+            uid = o.uid;
+            gid = o.gid;
+            groups = o.groups;
+            searchable.clear();
+        }
+        return *this;
+    }
+
+    bool isRoot() const { return uid == 0; }
+
+    bool inGroup(uint32_t g) const
+    {
+        return g == gid || std::find(groups.begin(), groups.end(), g) != groups.end();
+    }
+
+    static const Credentials &root()
+    {
+        static const Credentials r;
+        return r;
+    }
+
+private:
+    friend class FileSystem;
+    static constexpr size_t MaxCachedPrefixes = 4096;
+
+    // "/a/b" -> directory reached through searchable directories only; valid
+    // for one FileSystem while its access generation is unchanged
+    mutable std::mutex cacheMutex;
+    mutable const void *cacheOwner = nullptr;
+    mutable uint64_t cacheGeneration = 0;
+    mutable std::unordered_map<std::string, std::weak_ptr<DirectoryNode>> searchable;
+};
+
+static std::vector<std::string> splitPath(const std::string &path)
+{
+    std::vector<std::string> parts;
+    parts.reserve(std::count(path.begin(), path.end(), '/'));
+    for (size_t i = 0; i < path.size();)
+    {
+        size_t end = std::min(path.find('/', i), path.size());
+        if (end > i)
+            parts.emplace_back(path, i, end - i);
+        i = end + 1;
+    }
+    return parts;
+}
+
+// Shell-style wildcard match supporting '*' and '?'
+static bool globMatch(const std::string &pattern, const std::string &s)
+{
+    size_t p = 0, i = 0, star = std::string::npos, mark = 0;
+    while (i < s.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == s[i]))
+        {
+            p++;
+            i++;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            star = p++;
+            mark = i;
+        }
+        else if (star != std::string::npos)
+        {
+            p = star + 1;
+            i = ++mark;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+        p++;
+    return p == pattern.size();
+}
+
+/* -------------------- Extended attributes -------------------- */
+
+// A node's extended attributes packed into a single heap block:
+//   [u32 used][u32 capacity] then, sorted by name, per attribute
+//   [u8 nameLen][u32 valueLen][name][value]
+// Nodes without attributes only carry the null pointer, and a set of any
+// size is one allocation rather than a map node and two strings per entry.
+class XattrSet
+{
+private:
+    static constexpr size_t HeaderBytes = 8;
+    static constexpr size_t EntryHeader = 5;
+
+    std::unique_ptr<char[]> block;
+
+    static uint32_t load(const char *p)
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    static void store(char *p, uint32_t v) { memcpy(p, &v, 4); }
+
+    uint32_t used() const { return block ? load(block.get()) : 0; }
+    uint32_t capacity() const { return block ? load(block.get() + 4) : 0; }
+
+    static size_t entrySize(const char *e) { return EntryHeader + (uint8_t)e[0] + load(e + 1); }
+
+    // Offset of the entry named name, or of the first entry sorting after it
+    std::pair<size_t, bool> locate(std::string_view name) const
+    {
+        size_t off = HeaderBytes, end = used();
+        while (off < end)
+        {
+            const char *e = block.get() + off;
+            int c = std::string_view(e + EntryHeader, (uint8_t)e[0]).compare(name);
+            if (c >= 0)
+                return {off, c == 0};
+            off += entrySize(e);
+        }
+        return {off, false};
+    }
+
+    void reallocate(size_t cap)
+    {
+        std::unique_ptr<char[]> grown(new char[cap]);
+        size_t n = block ? used() : HeaderBytes;
+        if (block)
+            memcpy(grown.get(), block.get(), n);
+        store(grown.get(), (uint32_t)n);
+        store(grown.get() + 4, (uint32_t)cap);
+        block = std::move(grown);
+    }
+
+public:
+    static constexpr size_t MaxNameLength = 255;
+
+    XattrSet() = default;
+    XattrSet(XattrSet &&) = default;
+    XattrSet &operator=(XattrSet &&) = default;
+
+    XattrSet(const XattrSet &other) { *this = other; }
+
+    XattrSet &operator=(const XattrSet &other)
+    {
+        if (this == &other)
+            return *this;
+        block.reset();
+        if (other.block)
+        {
+            // copies are sized exactly; slack only matters for sets still growing
+            reallocate(other.used());
+            memcpy(block.get() + HeaderBytes, other.block.get() + HeaderBytes, other.used() - HeaderBytes);
+            store(block.get(), other.used());
+        }
+        return *this;
+    }
+
+    bool empty() const { return !block; }
+
+    std::optional<std::string_view> get(std::string_view name) const
+    {
+        auto [off, found] = locate(name);
+        if (!found)
+            return std::nullopt;
+        const char *e = block.get() + off;
+        return std::string_view(e + EntryHeader + (uint8_t)e[0], load(e + 1));
+    }
+
+    void set(std::string_view name, std::string_view value)
+    {
+        if (name.empty() || name.size() > MaxNameLength)
+            throw std::runtime_error("Attribute name must be 1 to 255 bytes");
+        if (value.size() > UINT32_MAX - HeaderBytes - EntryHeader - MaxNameLength)
+            throw std::runtime_error("Attribute value too large");
+        remove(name);
+        size_t need = EntryHeader + name.size() + value.size();
+        size_t n = used() ? used() : HeaderBytes;
+        if (n + need > capacity())
+            reallocate(std::max(n + need, (size_t)capacity() + capacity() / 2));
+        size_t off = locate(name).first;
+        char *e = block.get() + off;
+        memmove(e + need, e, n - off);
+        e[0] = (char)name.size();
+        store(e + 1, (uint32_t)value.size());
+        memcpy(e + EntryHeader, name.data(), name.size());
+        memcpy(e + EntryHeader + name.size(), value.data(), value.size());
+        store(block.get(), (uint32_t)(n + need));
+    }
+
+    bool remove(std::string_view name)
+    {
+        auto [off, found] = locate(name);
+        if (!found)
+            return false;
+        char *e = block.get() + off;
+        size_t sz = entrySize(e), n = used();
+        if (n - sz == HeaderBytes)
+        {
+            block.reset();
+            return true;
+        }
+        memmove(e, e + sz, n - off - sz);
+        store(block.get(), (uint32_t)(n - sz));
+        return true;
+    }
+
+    // Attribute names in sorted order
+    std::vector<std::string> names() const
+    {
+        std::vector<std::string> out;
+        for (size_t off = HeaderBytes, end = used(); off < end;)
+        {
+            const char *e = block.get() + off;
+            out.emplace_back(e + EntryHeader, (uint8_t)e[0]);
+            off += entrySize(e);
+        }
+        return out;
+    }
+
+    // Heap bytes held for the attributes
+    size_t bytes() const { return capacity(); }
+};
+
+/* -------------------- INode, DirectoryNode, FileNode -------------------- */
+
+// Seconds since the epoch in 32 bits (unsigned, so good until 2106).
+// Converts to and from time_t, clamping values outside that range.
+struct CompactTime
+{
+    uint32_t secs = 0;
+
+    CompactTime() = default;
+    CompactTime(time_t t) : secs(t < 0 ? 0 : (uint64_t)t > UINT32_MAX ? UINT32_MAX : (uint32_t)t) {}
+    operator time_t() const { return (time_t)secs; }
+
+    // For timestamps several threads may set at once
+    void storeRelaxed(time_t t)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __atomic_store_n(&secs, CompactTime(t).secs, __ATOMIC_RELAXED);
+#else
+        *this = t;
+#endif
+    }
+};
+
+// Node metadata packed into one cache line: no vtable (type-tagged dispatch
+// instead), permission bits in a 16-bit mode, 32-bit timestamps. Nodes are
+// only ever destroyed through a shared_ptr created for the concrete type, so
+// the destructor need not be virtual.
+struct INode
+{
+    std::string name;
+    XattrSet xattrs;
+    CompactTime created;
+    CompactTime modified;
+    uint32_t uid = 0;
+    uint32_t gid = 0;
+    uint16_t mode = 0644; // owner/group/others rwx as octal digits
+    NodeType type;
+    NumaPlacement placement; // where this node's contents are allocated
+
+    // New nodes take the placement in effect on the creating thread
+    INode(std::string _name, NodeType t) : name(move(_name)), type(t), placement(BufferAllocator::placement())
+    {
+        created = modified = time(nullptr);
+    }
+
+    Permissions perms() const { return {mode >> 6 & 7, mode >> 3 & 7, mode & 7}; }
+
+    void setPerms(Permissions p)
+    {
+        mode = (uint16_t)((p.owner & 7) << 6 | (p.group & 7) << 3 | (p.others & 7));
+    }
+
+    void copyMetadata(const INode &o)
+    {
+        mode = o.mode;
+        uid = o.uid;
+        gid = o.gid;
+        created = o.created;
+        modified = o.modified;
+        xattrs = o.xattrs;
+    }
+
+    bool permits(const Credentials &cred, unsigned want) const
+    {
+        if (cred.isRoot())
+            return true;
+        unsigned shift = cred.uid == uid ? 6 : cred.inGroup(gid) ? 3
+                                                                 : 0;
+        return ((mode >> shift) & want) == want;
+    }
+
+    std::shared_ptr<INode> cloneShallow() const; // copy metadata, not data
+};
+
+// File contents and directory tables come from BufferAllocator's size classes
+using FileData = PooledBuffer;
+
+// Nodes share one BufferAllocator block with their shared_ptr control block,
+// so node metadata sits in the allocator's slabs rather than all over the heap
+template <typename T, typename... Args>
+std::shared_ptr<T> makeNode(Args &&...args)
+{
+    return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+}
+
+struct DirectoryNode : INode
+{
+    ChildTable children;
+
+    DirectoryNode(const std::string &_name) : INode(_name, NodeType::Directory)
+    {
+        setPerms({7, 5, 5}); // directories are searchable by default
+    }
+
+    std::shared_ptr<INode> cloneShallow() const
+    {
+        // children not copied here, that is done in deep copy only
+        auto d = makeNode<DirectoryNode>(name);
+        d->copyMetadata(*this);
+        return d;
+    }
+
+    bool hasChild(const std::string &n) const
+    {
+        return children.contains(n);
+    }
+
+    std::shared_ptr<INode> getChild(const std::string &n) const
+    {
+        return children.find(n);
+    }
+
+    void addChild(const std::string &n, std::shared_ptr<INode> node)
+    {
+        BufferAllocator::PlacementScope scope(placement);
+        children.assign(n, std::move(node));
+        modified = time(nullptr);
+    }
+
+    // addChild for creators running concurrently under a shared tree lock on
+    // a sharded directory; false if the name is already taken
+    bool tryAddChild(const std::string &n, std::shared_ptr<INode> node)
+    {
+        BufferAllocator::PlacementScope scope(placement);
+        if (!children.insert(n, std::move(node)))
+            return false;
+        modified.storeRelaxed(time(nullptr));
+        return true;
+    }
+
+    // Callers hold the tree lock exclusively, so this is also the time to
+    // free what a lock-free table kept for concurrent readers
+    void removeChild(const std::string &n)
+    {
+        children.erase(n);
+        children.reclaim();
+        modified = time(nullptr);
+    }
+
+    std::vector<std::string> listNames() const
+    {
+        return children.sortedNames();
+    }
+};
+
+struct FileNode : INode
+{
+    // data is checksummed in fixed extents so an append only rehashes the tail
+    static constexpr size_t ChecksumExtent = 64 * 1024;
+
+    FileData data;
+    std::vector<uint32_t> checksums; // CRC32C of each ChecksumExtent bytes of data
+
+    // cache mode (FileSystem::setCacheLimit): slot in the eviction clock, and
+    // whether the file was read since the clock hand last passed, which
+    // reads set under the shared lock
+    uint32_t cacheSlot = EvictionClock::NoSlot;
+    std::atomic<bool> cacheReferenced{false};
+    bool cachePinned = false;
+
+    FileNode(const std::string &_name) : INode(_name, NodeType::File) {}
+
+    size_t size() const { return data.size(); }
+
+    std::shared_ptr<INode> cloneShallow() const
+    {
+        auto f = makeNode<FileNode>(name);
+        f->copyMetadata(*this);
+        f->data = data; // deep copy
+        f->checksums = checksums;
+        return f;
+    }
+
+    void write(const std::string &s, size_t offset = 0)
+    {
+        BufferAllocator::PlacementScope scope(placement);
+        size_t oldSize = data.size();
+        if (offset < data.size())
+            data.resize(offset);
+        if (offset + s.size() > data.size())
+            data.resize(offset + s.size());
+        copy(s.begin(), s.end(), data.begin() + offset);
+        updateChecksums(offset, oldSize);
+        modified = time(nullptr);
+    }
+
+    // Replace the contents
+    void assign(const char *p, size_t n)
+    {
+        BufferAllocator::PlacementScope scope(placement);
+        size_t oldSize = data.size();
+        data.assign(p, n);
+        updateChecksums(0, oldSize);
+    }
+
+    void setData(FileData &&d)
+    {
+        size_t oldSize = data.size();
+        data = std::move(d);
+        updateChecksums(0, oldSize);
+    }
+
+    void appendData(const char *p, size_t n)
+    {
+        BufferAllocator::PlacementScope scope(placement);
+        size_t oldSize = data.size();
+        data.append(p, n);
+        updateChecksums(oldSize, oldSize);
+    }
+
+    // Bring checksums up to date after a change that left the first `unchanged`
+    // bytes intact; the file was oldSize bytes long before. A pure append
+    // extends the CRC of the last partial extent instead of recomputing it.
+    void updateChecksums(size_t unchanged, size_t oldSize)
+    {
+        unchanged = std::min({unchanged, oldSize, data.size()});
+        size_t i = unchanged / ChecksumExtent;
+        size_t pos = i * ChecksumExtent;
+        uint32_t crc = 0;
+        if (unchanged % ChecksumExtent && unchanged == oldSize && i < checksums.size())
+        {
+            crc = checksums[i];
+            pos = unchanged;
+        }
+        checksums.resize(i);
+        while (pos < data.size())
+        {
+            size_t end = std::min(data.size(), (pos / ChecksumExtent + 1) * ChecksumExtent);
+            checksums.push_back(crc32c(crc, data.data() + pos, end - pos));
+            crc = 0;
+            pos = end;
+        }
+    }
+
+    // Check the extents overlapping [offset, offset + len)
+    bool verify(size_t offset = 0, size_t len = std::string::npos) const
+    {
+        if (checksums.size() != (data.size() + ChecksumExtent - 1) / ChecksumExtent)
+            return false;
+        size_t end = len > data.size() - std::min(offset, data.size()) ? data.size() : offset + len;
+        for (size_t i = offset / ChecksumExtent; i * ChecksumExtent < end; i++)
+        {
+            size_t from = i * ChecksumExtent;
+            size_t to = std::min(data.size(), from + ChecksumExtent);
+            if (crc32c(0, data.data() + from, to - from) != checksums[i])
+                return false;
+        }
+        return true;
+    }
+
+    std::string readAll() const
+    {
+        return std::string(data.begin(), data.end());
+    }
+};
+
+inline std::shared_ptr<INode> INode::cloneShallow() const
+{
+    if (type == NodeType::File)
+        return static_cast<const FileNode *>(this)->cloneShallow();
+    return static_cast<const DirectoryNode *>(this)->cloneShallow();
+}
+
+/* -------------------- FileSystem Class -------------------- */
+
+class FileSystem
+{
+private:
+    friend class AsyncFileSystem;
+    friend class TarArchive;
+    friend class HostTransfer;
+    friend class ChecksumScrubber;
+    friend class NodeTable;
+    friend class ObjectStore;
+    friend class TtlExpirer;
+
+    std::shared_ptr<DirectoryNode> root;
+    // guards the whole tree: lookups take it shared, mutations exclusive
+    mutable std::shared_mutex treeMutex;
+    std::atomic<bool> verifyOnRead{false};
+    // live sharded or lock-free directories; each table drops its count when
+    // it is unsharded or freed, so plain trees skip the shared create path
+    std::shared_ptr<std::atomic<size_t>> concurrentDirs = std::make_shared<std::atomic<size_t>>(0);
+
+    // bumped whenever a directory that callers may have cached in their
+    // Credentials is moved, removed or has its permissions changed
+    uint64_t accessGeneration = 0;
+    // directories by path for root walks, valid while accessGeneration is
+    // unchanged (non-root callers use the prefix cache in their Credentials)
+    PathCache pathCache;
+    // every path below the root when enabled, for ordered prefix queries;
+    // indexMutex guards it against creators running under the shared lock
+    std::unique_ptr<PathIndex> pathIndex;
+    std::mutex indexMutex;
+    // every file in cache mode, for picking what to evict; cacheMutex
+    // guards it and cacheTotals like indexMutex does the path index
+    std::unique_ptr<EvictionClock> evictionClock;
+    size_t cacheLimit = 0;
+    CacheStats cacheTotals;
+    std::mutex cacheMutex;
+
+    static std::string prefixKey(const std::vector<std::string> &parts, size_t depth)
+    {
+        std::string key;
+        for (size_t i = 0; i < depth; i++)
+            key += "/" + parts[i];
+        return key;
+    }
+
+    std::shared_ptr<DirectoryNode> cachedSearchable(const Credentials &cred, const std::string &key)
+    {
+        std::lock_guard lock(cred.cacheMutex);
+        if (cred.cacheOwner != this || cred.cacheGeneration != accessGeneration)
+        {
+            cred.searchable.clear();
+            cred.cacheOwner = this;
+            cred.cacheGeneration = accessGeneration;
+            return nullptr;
+        }
+        auto it = cred.searchable.find(key);
+        return it == cred.searchable.end() ? nullptr : it->second.lock();
+    }
+
+    void rememberSearchable(const Credentials &cred, const std::string &key, const std::shared_ptr<DirectoryNode> &dir)
+    {
+        std::lock_guard lock(cred.cacheMutex);
+        if (cred.cacheOwner != this || cred.cacheGeneration != accessGeneration)
+            return;
+        if (cred.searchable.size() >= Credentials::MaxCachedPrefixes)
+            cred.searchable.clear();
+        cred.searchable.emplace(key, dir);
+    }
+
+    static void requireAccess(const INode &node, const Credentials &cred, unsigned want, const std::string &path)
+    {
+        if (!node.permits(cred, want))
+            throw PermissionDenied(path);
+    }
+
+    // Walk parts[from, depth) down from curr. Errors use traverseNode's or
+    // resolveParent's wording depending on forTraverse.
+    static std::shared_ptr<DirectoryNode> descend(std::shared_ptr<DirectoryNode> curr,
+                                                  const std::vector<std::string> &parts, size_t from, size_t depth,
+                                                  const Credentials &cred, const std::string &path, bool forTraverse)
+    {
+        for (size_t i = from; i < depth; i++)
+        {
+            const std::string &p = parts[i];
+            if (!cred.isRoot())
+                requireAccess(*curr, cred, MayExec, path);
+            auto child = curr->getChild(p);
+            if (!child)
+                throw std::runtime_error("Path " + p + " not found");
+            if (child->type != NodeType::Directory)
+            {
+                throw std::runtime_error(forTraverse ? "Path traversed into file instead of directory"
+                                                     : p + " is not a directory");
+            }
+            curr = std::static_pointer_cast<DirectoryNode>(child);
+        }
+        return curr;
+    }
+
+    // The directory reached through parts[0, depth). For non-root cred every
+    // directory on the way, including the last, must be searchable; a cached
+    // prefix skips those checks.
+    std::shared_ptr<DirectoryNode> walkDirectories(const std::vector<std::string> &parts, size_t depth,
+                                                   const Credentials &cred, const std::string &path, bool forTraverse)
+    {
+        std::string key;
+        if (!cred.isRoot())
+        {
+            key = prefixKey(parts, depth);
+            if (auto dir = cachedSearchable(cred, key))
+                return dir;
+        }
+        auto curr = descend(root, parts, 0, depth, cred, path, forTraverse);
+        if (!cred.isRoot())
+        {
+            requireAccess(*curr, cred, MayExec, path);
+            rememberSearchable(cred, key, curr);
+        }
+        return curr;
+    }
+
+    // For root lookups: the directory at path[0, end), where path[end] is a
+    // '/'. Starts from the deepest of its last few ancestors in pathCache, so
+    // only the rest is split and walked. Null if the cache is off.
+    std::shared_ptr<DirectoryNode> walkCached(const std::string &path, size_t end, bool forTraverse)
+    {
+        if (!pathCache.enabled())
+            return nullptr;
+        constexpr size_t Probes = 16;
+        std::string_view view(path);
+        std::shared_ptr<DirectoryNode> curr = root;
+        size_t from = 0;
+        uint64_t hash = 0;
+        for (size_t k = 0, at = end; k < Probes && at > 0; k++, at = view.rfind('/', at - 1))
+        {
+            uint64_t h = PathCache::hashOf(view.substr(0, at));
+            if (k == 0)
+                hash = h;
+            if (auto dir = pathCache.find(h, view.substr(0, at), accessGeneration))
+            {
+                curr = std::move(dir);
+                from = at;
+                break;
+            }
+        }
+        if (from == end)
+            return curr;
+        auto rest = splitPath(path.substr(from, end - from));
+        curr = descend(std::move(curr), rest, 0, rest.size(), Credentials::root(), path, forTraverse);
+        pathCache.insert(hash, view.substr(0, end), accessGeneration, curr);
+        return curr;
+    }
+
+    // Resolve path and return pair(parentNode, targetNodeName); cred must be
+    // allowed `want` on the parent. "." and ".." are resolved first.
+    std::pair<std::shared_ptr<DirectoryNode>, std::string> resolveParent(const std::string &rawPath,
+                                                                         const Credentials &cred = Credentials::root(),
+                                                                         unsigned want = 0)
+    {
+        std::string scratch;
+        const std::string &path = canonicalPath(rawPath, scratch);
+        if (path.empty() || path[0] != '/')
+            throw std::runtime_error("Path must not be empty and should start with \'/\'");
+        size_t slash = path.rfind('/');
+        if (cred.isRoot() && slash + 1 < path.size())
+        {
+            if (auto parent = walkCached(path, slash, false))
+            {
+                requireAccess(*parent, cred, want, path);
+                return std::make_pair(parent, path.substr(slash + 1));
+            }
+        }
+        auto parts = splitPath(path);
+        if (parts.empty())
+            throw std::runtime_error("Invalid root parent");
+
+        auto parent = walkDirectories(parts, parts.size() - 1, cred, path, false);
+        requireAccess(*parent, cred, want, path);
+        return std::make_pair(parent, parts.back());
+    }
+
+    // resolveParent that creates missing directories on the way, owned by
+    // cred, instead of failing. One walk: each component is looked up once
+    // and created right there if it is missing, and root starts from the
+    // deepest ancestor in pathCache. Needs the tree lock exclusively.
+    std::pair<std::shared_ptr<DirectoryNode>, std::string> resolveParentCreating(const std::string &rawPath,
+                                                                                 const Credentials &cred, unsigned want)
+    {
+        std::string scratch;
+        const std::string &path = canonicalPath(rawPath, scratch);
+        if (path.empty() || path[0] != '/')
+            throw std::runtime_error("Path must not be empty and should start with \'/\'");
+        size_t last = path.rfind('/');
+        if (last + 1 == path.size())
+            throw std::runtime_error("Invalid root parent");
+
+        std::string_view view(path);
+        std::shared_ptr<DirectoryNode> curr = root;
+        size_t from = 0;
+        if (cred.isRoot() && pathCache.enabled())
+        {
+            // as in walkCached, a few of the deepest ancestors
+            constexpr size_t Probes = 16;
+            for (size_t k = 0, at = last; k < Probes && at > 0; k++, at = view.rfind('/', at - 1))
+                if (auto dir = pathCache.find(PathCache::hashOf(view.substr(0, at)), view.substr(0, at),
+                                              accessGeneration))
+                {
+                    curr = std::move(dir);
+                    from = at;
+                    break;
+                }
+        }
+        for (size_t start = from + 1; start <= last;)
+        {
+            size_t end = path.find('/', start);
+            std::string p = path.substr(start, end - start);
+            if (!cred.isRoot())
+                requireAccess(*curr, cred, MayExec, path);
+            auto child = curr->getChild(p);
+            if (!child)
+            {
+                requireAccess(*curr, cred, MayWrite, path);
+                BufferAllocator::PlacementScope scope(curr->placement);
+                auto dir = makeNode<DirectoryNode>(p);
+                adopt(*dir, cred);
+                curr->addChild(p, dir);
+                noteLinked(path.substr(0, end), *dir);
+                child = dir;
+            }
+            else if (child->type != NodeType::Directory)
+                throw std::runtime_error(p + " is not a directory");
+            curr = std::static_pointer_cast<DirectoryNode>(child);
+            start = end + 1;
+        }
+        if (cred.isRoot() && pathCache.enabled() && last > from)
+            pathCache.insert(PathCache::hashOf(view.substr(0, last)), view.substr(0, last), accessGeneration, curr);
+        if (!cred.isRoot())
+            requireAccess(*curr, cred, MayExec, path);
+        requireAccess(*curr, cred, want, path);
+        return std::make_pair(curr, path.substr(last + 1));
+    }
+
+    // The parent of a path about to be created, which cred must be allowed
+    // to write; with createParents its missing ancestors are created first
+    std::pair<std::shared_ptr<DirectoryNode>, std::string> resolveNewParent(const std::string &path,
+                                                                            const Credentials &cred, bool createParents)
+    {
+        return createParents ? resolveParentCreating(path, cred, MayWrite) : resolveParent(path, cred, MayWrite);
+    }
+
+    // A parent createShared resolved under the shared lock but could not
+    // create in. Still good under the exclusive lock while accessGeneration
+    // is unchanged: moving, removing or re-permissioning any directory bumps it.
+    struct ResolvedParent
+    {
+        std::shared_ptr<DirectoryNode> dir; // null if nothing was resolved
+        std::string name;
+        uint64_t generation = 0;
+    };
+
+    // resolveNewParent, skipping the walk if hint still holds. Needs the
+    // tree lock exclusively.
+    std::pair<std::shared_ptr<DirectoryNode>, std::string> resolveNewParent(const std::string &path,
+                                                                            const Credentials &cred, bool createParents,
+                                                                            ResolvedParent &hint)
+    {
+        if (hint.dir && hint.generation == accessGeneration)
+            return {std::move(hint.dir), std::move(hint.name)};
+        return resolveNewParent(path, cred, createParents);
+    }
+
+    // Traverse the whole path and return node pointer; cred must be allowed
+    // `want` on the node itself. "." and ".." are resolved first.
+    std::shared_ptr<INode> traverseNode(const std::string &rawPath, const Credentials &cred = Credentials::root(),
+                                        unsigned want = 0)
+    {
+        std::string scratch;
+        const std::string &path = canonicalPath(rawPath, scratch);
+        if (path == "/")
+        {
+            requireAccess(*root, cred, want, path);
+            return root;
+        }
+        if (path.empty() || path[0] != '/')
+            throw std::runtime_error("Path must not be empty and should start with \'/\'");
+        size_t slash = path.rfind('/');
+        std::shared_ptr<DirectoryNode> dir;
+        std::string name;
+        if (cred.isRoot() && slash + 1 < path.size() && (dir = walkCached(path, slash, true)))
+            name = path.substr(slash + 1);
+        else
+        {
+            auto parts = splitPath(path);
+            if (parts.empty())
+            {
+                requireAccess(*root, cred, want, path);
+                return root;
+            }
+            dir = walkDirectories(parts, parts.size() - 1, cred, path, true);
+            name = std::move(parts.back());
+        }
+        auto node = dir->getChild(name);
+        if (!node)
+            throw std::runtime_error("Path " + name + " not found");
+        requireAccess(*node, cred, want, path);
+        return node;
+    }
+
+    std::shared_ptr<INode> deepCopyNode(const std::shared_ptr<INode> &src)
+    {
+        if (src->type == NodeType::File)
+        {
+            // file cloneShallow copies data as well
+            return src->cloneShallow();
+        }
+        else
+        {
+            auto srcDir = std::static_pointer_cast<DirectoryNode>(src);
+            auto newDir = std::static_pointer_cast<DirectoryNode>(srcDir->cloneShallow());
+            srcDir->children.forEach([&](const std::string &name, const std::shared_ptr<INode> &child)
+                                     {
+                auto childCopy = deepCopyNode(child);
+                childCopy->name = name; // ensure copied child name matches key
+                newDir->addChild(name, childCopy); });
+            return newDir;
+        }
+    }
+
+    // Keys are tagged with the node's type
+    void indexSubtree(const std::string &path, const INode &node)
+    {
+        pathIndex->insert(path, (uint8_t)node.type);
+        if (node.type == NodeType::Directory)
+            static_cast<const DirectoryNode &>(node).children.forEach(
+                [&](const std::string &name, const std::shared_ptr<INode> &child)
+                { indexSubtree(path + "/" + name, *child); });
+    }
+
+    void trackSubtree(const std::string &path, INode &node)
+    {
+        if (node.type == NodeType::Directory)
+        {
+            static_cast<DirectoryNode &>(node).children.forEach(
+                [&](const std::string &name, const std::shared_ptr<INode> &child)
+                { trackSubtree(path + "/" + name, *child); });
+            return;
+        }
+        auto &file = static_cast<FileNode &>(node);
+        // arrivals start unreferenced, so files written once and never read
+        // are the first to go
+        file.cacheSlot = evictionClock->add(&file, path, file.size());
+    }
+
+    void untrackSubtree(INode &node)
+    {
+        if (node.type == NodeType::Directory)
+        {
+            static_cast<DirectoryNode &>(node).children.forEach(
+                [&](const std::string &, const std::shared_ptr<INode> &child)
+                { untrackSubtree(*child); });
+            return;
+        }
+        auto &file = static_cast<FileNode &>(node);
+        evictionClock->remove(file.cacheSlot, &file);
+        file.cacheSlot = EvictionClock::NoSlot;
+    }
+
+    // Record a node newly linked at path, and everything below it, in the
+    // path index and the eviction clock
+    void noteLinked(const std::string &path, INode &node)
+    {
+        if (!pathIndex && !evictionClock)
+            return;
+        std::string scratch;
+        const std::string &canon = canonicalPath(path, scratch);
+        if (pathIndex)
+        {
+            std::lock_guard lock(indexMutex);
+            indexSubtree(canon, node);
+        }
+        if (evictionClock)
+        {
+            std::lock_guard lock(cacheMutex);
+            trackSubtree(canon, node);
+        }
+    }
+
+    // Forget node, just unlinked from path, and everything below it
+    void noteUnlinked(const std::string &path, INode &node)
+    {
+        if (pathIndex)
+        {
+            std::string scratch;
+            const std::string &canon = canonicalPath(path, scratch);
+            std::lock_guard lock(indexMutex);
+            pathIndex->erase(canon);
+            pathIndex->erasePrefix(canon + "/");
+        }
+        if (evictionClock)
+        {
+            std::lock_guard lock(cacheMutex);
+            untrackSubtree(node);
+        }
+    }
+
+    // Charge a file whose contents changed in place for its new size
+    void noteResized(const FileNode &file)
+    {
+        if (!evictionClock || file.cacheSlot == EvictionClock::NoSlot)
+            return;
+        std::lock_guard lock(cacheMutex);
+        evictionClock->resize(file.cacheSlot, file.size());
+    }
+
+    void noteRead(FileNode &file)
+    {
+        if (evictionClock)
+            file.cacheReferenced.store(true, std::memory_order_relaxed);
+    }
+
+    // In cache mode, evict files until their contents fit cacheLimit again,
+    // passing over pinned ones, keep (the file just written) and, once each,
+    // those read since the hand last came by. The victims go to evicted for
+    // the caller to free after it drops the tree lock, which it holds
+    // exclusively.
+    void enforceCacheLimit(const FileNode *keep, std::vector<std::shared_ptr<INode>> &evicted)
+    {
+        while (evictionClock)
+        {
+            uint32_t slot;
+            const FileNode *file;
+            std::string path;
+            size_t bytes;
+            {
+                std::lock_guard lock(cacheMutex);
+                if (evictionClock->bytes() <= cacheLimit)
+                    return;
+                slot = evictionClock->next(
+                    [&](FileNode *f)
+                    {
+                        if (f == keep || f->cachePinned)
+                        {
+                            cacheTotals.pinnedSkips++;
+                            return true;
+                        }
+                        if (f->cacheReferenced.exchange(false, std::memory_order_relaxed))
+                        {
+                            cacheTotals.secondChances++;
+                            return true;
+                        }
+                        return false;
+                    });
+                if (slot == EvictionClock::NoSlot)
+                    return; // everything left is pinned
+                const auto &victim = evictionClock->at(slot);
+                file = victim.file;
+                path = victim.path;
+                bytes = victim.bytes;
+            }
+            std::shared_ptr<INode> node;
+            try
+            {
+                node = traverseNode(path);
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+            if (node.get() != file)
+            {
+                // already gone from that path: just forget it
+                std::lock_guard lock(cacheMutex);
+                evictionClock->remove(slot, file);
+                continue;
+            }
+            evicted.push_back(detachNode(path, false));
+            std::lock_guard lock(cacheMutex);
+            cacheTotals.evictions++;
+            cacheTotals.evictedBytes += bytes;
+        }
+    }
+
+    const PathIndex &requirePathIndex() const
+    {
+        if (!pathIndex)
+            throw std::runtime_error("Path index is off");
+        return *pathIndex;
+    }
+
+    // Unlink the node at path from its parent and hand it back to the caller
+    std::shared_ptr<INode> detachNode(const std::string &path, bool recursive,
+                                      const Credentials &cred = Credentials::root())
+    {
+        if (path == "/")
+            throw std::runtime_error("Can't remove root");
+        auto [parent, name] = resolveParent(path, cred, MayWrite);
+        auto node = parent->getChild(name);
+        if (!node)
+            throw std::runtime_error(name + " not found");
+        if (node->type == NodeType::Directory)
+        {
+            auto dir = std::static_pointer_cast<DirectoryNode>(node);
+            if (!dir->children.empty() && !recursive)
+                throw std::runtime_error("Directory not empty");
+        }
+        parent->removeChild(name);
+        noteUnlinked(path, *node);
+        if (node->type == NodeType::Directory)
+            accessGeneration++;
+        return node;
+    }
+
+    // Create a node in a sharded or lock-free directory under the shared
+    // lock, so creates in one directory run side by side. False if the
+    // parent takes neither, or is missing and createParents is set, and the
+    // caller should use the exclusive path; in the first case the parent is
+    // left in resolved so that path need not walk again.
+    template <typename T>
+    bool createShared(const Credentials &cred, const std::string &path, bool createParents, ResolvedParent &resolved)
+    {
+        std::shared_lock lock(treeMutex);
+        std::shared_ptr<DirectoryNode> parent;
+        std::string name;
+        try
+        {
+            std::tie(parent, name) = resolveParent(path, cred, MayWrite);
+        }
+        catch (const PermissionDenied &)
+        {
+            throw;
+        }
+        catch (const std::runtime_error &)
+        {
+            if (createParents)
+                return false;
+            throw;
+        }
+        if (!parent->children.concurrent())
+        {
+            resolved = {std::move(parent), std::move(name), accessGeneration};
+            return false;
+        }
+        BufferAllocator::PlacementScope scope(parent->placement);
+        auto node = makeNode<T>(name);
+        adopt(*node, cred);
+        if (!parent->tryAddChild(name, node))
+            throw std::runtime_error(name + " already exists");
+        noteLinked(path, *node);
+        return true;
+    }
+
+    // Give a subtree created on behalf of cred to that caller
+    static void adopt(INode &node, const Credentials &cred)
+    {
+        node.uid = cred.uid;
+        node.gid = cred.gid;
+        if (node.type == NodeType::Directory)
+            static_cast<DirectoryNode &>(node).children.forEach(
+                [&](const std::string &, const std::shared_ptr<INode> &child)
+                { adopt(*child, cred); });
+    }
+
+    // Link a copy of a node named srcName at dest, following cp semantics:
+    // into dest if it is a directory, otherwise as dest itself.
+    // makeCopy is only invoked once dest has been validated.
+    void placeCopy(const std::string &srcName, const std::string &dest,
+                   const std::function<std::shared_ptr<INode>()> &makeCopy,
+                   const Credentials &cred = Credentials::root())
+    {
+        try
+        {
+            auto destNode = traverseNode(dest, cred);
+            if (destNode->type == NodeType::Directory)
+            {
+                auto destDir = std::static_pointer_cast<DirectoryNode>(destNode);
+                requireAccess(*destDir, cred, MayWrite, dest);
+                if (destDir->hasChild(srcName))
+                    throw std::runtime_error("Target with same name exists in destination");
+                BufferAllocator::PlacementScope scope(destDir->placement);
+                auto copyNode = makeCopy();
+                if (!cred.isRoot())
+                    adopt(*copyNode, cred);
+                copyNode->name = srcName;
+                destDir->addChild(copyNode->name, copyNode);
+                noteLinked(dest + "/" + srcName, *copyNode);
+                return;
+            }
+            else
+            {
+                throw std::runtime_error("Destination exists and is not a directory");
+            }
+        }
+        catch (const PermissionDenied &)
+        {
+            throw;
+        }
+        catch (...)
+        {
+            // dest does not exist
+            auto [destParent, destName] = resolveParent(dest, cred, MayWrite);
+            if (destParent->hasChild(destName))
+                throw std::runtime_error("Destination exists");
+            BufferAllocator::PlacementScope scope(destParent->placement);
+            auto copyNode = makeCopy();
+            if (!cred.isRoot())
+                adopt(*copyNode, cred);
+            copyNode->name = destName;
+            destParent->addChild(copyNode->name, copyNode);
+            noteLinked(dest, *copyNode);
+            return;
+        }
+    }
+
+    size_t diskUsage(const std::shared_ptr<INode> &node)
+    {
+        if (node->type == NodeType::File)
+            return std::static_pointer_cast<FileNode>(node)->size();
+        size_t total = 0;
+        std::static_pointer_cast<DirectoryNode>(node)->children.forEach(
+            [&](const std::string &, const std::shared_ptr<INode> &child)
+            { total += diskUsage(child); });
+        return total;
+    }
+
+    void findNodes(const std::shared_ptr<INode> &node, const std::string &path, const std::string &pattern,
+                   std::vector<std::string> &out)
+    {
+        if (globMatch(pattern, node->name))
+            out.push_back(path);
+        if (node->type != NodeType::Directory)
+            return;
+        std::static_pointer_cast<DirectoryNode>(node)->children.forEach(
+            [&](const std::string &name, const std::shared_ptr<INode> &child)
+            { findNodes(child, (path == "/" ? "" : path) + "/" + name, pattern, out); });
+    }
+
+    void printTreeNode(std::ostream &out, const std::shared_ptr<INode> &node, int depth)
+    {
+        std::string indent(depth * 2, ' ');
+        if (node->type == NodeType::File)
+        {
+            out << indent << "- " << node->name << " (file, size=" << std::static_pointer_cast<FileNode>(node)->size() << ")\n";
+        }
+        else
+        {
+            auto dir = std::static_pointer_cast<DirectoryNode>(node);
+            out << indent << "+ " << dir->name << " (dir)\n";
+            dir->children.forEach([&](const std::string &, const std::shared_ptr<INode> &child)
+                                  { printTreeNode(out, child, depth + 1); });
+        }
+    }
+
+public:
+    FileSystem()
+    {
+        root = makeNode<DirectoryNode>("/");
+        root->name = "/";
+    }
+
+    // Check file checksums on every read (off by default)
+    void setVerifyOnRead(bool on) { verifyOnRead = on; }
+
+    // Slots in the cache of directories by path used by root lookups
+    // (PathCache::DefaultSlots to start with); 0 turns it off
+    void setPathCacheSize(size_t slots)
+    {
+        std::unique_lock lock(treeMutex);
+        pathCache.resize(slots);
+    }
+
+    // Keep an index of every path for listPrefix, listRange and
+    // longestPrefix (off by default). Turning it on indexes the current tree;
+    // afterwards every create, move and remove updates it.
+    void setPathIndex(bool on)
+    {
+        std::unique_lock lock(treeMutex);
+        if (!on)
+        {
+            pathIndex.reset();
+            return;
+        }
+        if (pathIndex)
+            return;
+        pathIndex = std::make_unique<PathIndex>();
+        root->children.forEach([&](const std::string &name, const std::shared_ptr<INode> &child)
+                               { indexSubtree("/" + name, *child); });
+    }
+
+    // Cache mode: keep the total size of file contents within limit bytes.
+    // When write, append, cp (sync or async) or a tar or host import would go
+    // over, unpinned files are evicted (removed) in roughly least recently
+    // read order until it fits; the file being written is never chosen. 0 turns cache mode off (the default).
+    // Turning it on starts tracking the current tree.
+    void setCacheLimit(size_t limit)
+    {
+        std::vector<std::shared_ptr<INode>> evicted; // freed after the lock is released
+        std::unique_lock lock(treeMutex);
+        {
+            std::lock_guard cacheLock(cacheMutex);
+            cacheLimit = limit;
+            if (!limit)
+            {
+                evictionClock.reset();
+                return;
+            }
+            if (!evictionClock)
+            {
+                evictionClock = std::make_unique<EvictionClock>();
+                root->children.forEach([&](const std::string &name, const std::shared_ptr<INode> &child)
+                                       { trackSubtree("/" + name, *child); });
+            }
+        }
+        enforceCacheLimit(nullptr, evicted);
+    }
+
+    // Pinned files are never evicted in cache mode
+    void pin(const std::string &path, bool pinned = true)
+    {
+        std::unique_lock lock(treeMutex);
+        auto node = traverseNode(path);
+        if (node->type != NodeType::File)
+            throw std::runtime_error(path + " is a directory");
+        std::static_pointer_cast<FileNode>(node)->cachePinned = pinned;
+    }
+
+    void unpin(const std::string &path) { pin(path, false); }
+
+    CacheStats cacheStats()
+    {
+        std::shared_lock lock(treeMutex);
+        std::lock_guard cacheLock(cacheMutex);
+        CacheStats s = cacheTotals;
+        s.limit = cacheLimit;
+        if (evictionClock)
+        {
+            s.bytes = evictionClock->bytes();
+            s.files = evictionClock->files();
+        }
+        return s;
+    }
+
+    // Up to limit paths starting with prefix (as text: "/logs/2026-1"
+    // matches "/logs/2026-10/a" and "/logs/2026-11"), at any depth, in byte
+    // order. Needs the path index.
+    std::vector<std::string> listPrefix(const std::string &prefix, size_t limit = SIZE_MAX)
+    {
+        std::shared_lock lock(treeMutex);
+        std::lock_guard indexLock(indexMutex);
+        return requirePathIndex().withPrefix(prefix, limit);
+    }
+
+    // Up to limit paths in [from, to), in byte order. Needs the path index.
+    std::vector<std::string> listRange(const std::string &from, const std::string &to, size_t limit = SIZE_MAX)
+    {
+        std::shared_lock lock(treeMutex);
+        std::lock_guard indexLock(indexMutex);
+        return requirePathIndex().range(from, to, limit);
+    }
+
+    // The deepest existing node on the way to path: path itself if it
+    // exists, otherwise its closest existing ancestor ("/" at worst). Needs
+    // the path index.
+    std::string longestPrefix(const std::string &path)
+    {
+        std::string scratch;
+        const std::string &canon = canonicalPath(path, scratch);
+        std::shared_lock lock(treeMutex);
+        std::lock_guard indexLock(indexMutex);
+        size_t len = requirePathIndex().longestPrefix(canon);
+        return len ? canon.substr(0, len) : "/";
+    }
+
+    // Each operation below also has an overload taking the caller's
+    // Credentials first; the plain forms run as root. Checks follow POSIX:
+    // search (x) on every directory walked through, write on the parent to
+    // create or unlink, read/write on the target to read or modify it.
+
+    void mkdir(const std::string &path) { mkdir(Credentials::root(), path); }
+    void mkdirs(const std::string &path) { mkdirs(Credentials::root(), path); }
+
+    void mkdir(const Credentials &cred, const std::string &path)
+    {
+        ResolvedParent resolved;
+        if (concurrentDirs->load(std::memory_order_relaxed) && createShared<DirectoryNode>(cred, path, false, resolved))
+            return;
+        std::unique_lock lock(treeMutex);
+        auto [parent, name] = resolveNewParent(path, cred, false, resolved);
+        if (parent->hasChild(name))
+            throw std::runtime_error(name + " already exists");
+        BufferAllocator::PlacementScope scope(parent->placement);
+        auto dir = makeNode<DirectoryNode>(name);
+        adopt(*dir, cred);
+        parent->addChild(name, dir);
+        noteLinked(path, *dir);
+    }
+
+    // mkdir -p: create path and any missing directories above it in one
+    // walk. Fine if path is already a directory; that case, like every
+    // repeat call on ingest, only takes the tree lock shared.
+    void mkdirs(const Credentials &cred, const std::string &path)
+    {
+        {
+            std::shared_lock lock(treeMutex);
+            std::shared_ptr<INode> node;
+            try
+            {
+                node = traverseNode(path, cred);
+            }
+            catch (const PermissionDenied &)
+            {
+                throw;
+            }
+            catch (const std::runtime_error &)
+            {
+                // missing somewhere (or a file on the way, reported below)
+            }
+            if (node && node->type == NodeType::Directory)
+                return;
+            if (node)
+                throw std::runtime_error(path + " already exists");
+        }
+        std::unique_lock lock(treeMutex);
+        auto [parent, name] = resolveParentCreating(path, cred, MayWrite);
+        if (auto existing = parent->getChild(name))
+        {
+            if (existing->type == NodeType::Directory)
+                return;
+            throw std::runtime_error(name + " already exists");
+        }
+        BufferAllocator::PlacementScope scope(parent->placement);
+        auto dir = makeNode<DirectoryNode>(name);
+        adopt(*dir, cred);
+        parent->addChild(name, dir);
+        noteLinked(path, *dir);
+    }
+
+    // With createParents, touch and write create missing directories above
+    // path as mkdirs does instead of failing
+    void touch(const std::string &path, bool createParents = false) { touch(Credentials::root(), path, createParents); }
+
+    void touch(const Credentials &cred, const std::string &path, bool createParents = false)
+    {
+        ResolvedParent resolved;
+        if (concurrentDirs->load(std::memory_order_relaxed) && createShared<FileNode>(cred, path, createParents, resolved))
+            return;
+        std::unique_lock lock(treeMutex);
+        auto [parent, name] = resolveNewParent(path, cred, createParents, resolved);
+        if (parent->hasChild(name))
+            throw std::runtime_error(name + " already exists");
+        BufferAllocator::PlacementScope scope(parent->placement);
+        auto file = makeNode<FileNode>(name);
+        adopt(*file, cred);
+        parent->addChild(name, file);
+        noteLinked(path, *file);
+    }
+
+    void write(const std::string &path, const std::string &content, bool createParents = false)
+    {
+        write(Credentials::root(), path, content, createParents);
+    }
+
+    void write(const Credentials &cred, const std::string &path, const std::string &content,
+               bool createParents = false)
+    {
+        std::vector<std::shared_ptr<INode>> evicted; // freed after the lock is released
+        std::unique_lock lock(treeMutex);
+        std::shared_ptr<FileNode> file;
+        try
+        {
+            auto node = traverseNode(path, cred, MayWrite);
+            if (node->type != NodeType::File)
+                throw std::runtime_error("Can't write to directory " + path);
+            file = std::static_pointer_cast<FileNode>(node);
+            file->assign(content.data(), content.size());
+            file->modified = time(nullptr);
+            noteResized(*file);
+        }
+        catch (const PermissionDenied &)
+        {
+            throw;
+        }
+        catch (const std::runtime_error &)
+        {
+            // create file if path not found; a directory there stays put
+            auto [parent, name] = resolveNewParent(path, cred, createParents);
+            if (parent->hasChild(name))
+                throw;
+            BufferAllocator::PlacementScope scope(parent->placement);
+            file = makeNode<FileNode>(name);
+            adopt(*file, cred);
+            file->assign(content.data(), content.size());
+            parent->addChild(name, file);
+            noteLinked(path, *file);
+        }
+        enforceCacheLimit(file.get(), evicted);
+    }
+
+    void append(const std::string &path, const std::string &content) { append(Credentials::root(), path, content); }
+
+    void append(const Credentials &cred, const std::string &path, const std::string &content)
+    {
+        std::vector<std::shared_ptr<INode>> evicted; // freed after the lock is released
+        std::unique_lock lock(treeMutex);
+        std::shared_ptr<FileNode> file;
+        try
+        {
+            auto node = traverseNode(path, cred, MayWrite);
+            if (node->type != NodeType::File)
+                throw std::runtime_error("Can't append to directory " + path);
+            file = std::static_pointer_cast<FileNode>(node);
+            file->appendData(content.data(), content.size());
+            file->modified = time(nullptr);
+            noteResized(*file);
+        }
+        catch (const PermissionDenied &)
+        {
+            throw;
+        }
+        catch (...)
+        {
+            // create file if path not found (same checks as touch)
+            auto [parent, name] = resolveParent(path, cred, MayWrite);
+            if (parent->hasChild(name))
+                throw std::runtime_error(name + " already exists");
+            BufferAllocator::PlacementScope scope(parent->placement);
+            file = makeNode<FileNode>(name);
+            adopt(*file, cred);
+            file->assign(content.data(), content.size());
+            parent->addChild(name, file);
+            noteLinked(path, *file);
+        }
+        enforceCacheLimit(file.get(), evicted);
+    }
+
+    std::string read(const std::string &path) { return read(Credentials::root(), path); }
+
+    std::string read(const Credentials &cred, const std::string &path)
+    {
+        std::shared_lock lock(treeMutex);
+        auto node = traverseNode(path, cred, MayRead);
+        if (node->type != NodeType::File)
+            throw std::runtime_error(path + " is a directory");
+        auto file = std::static_pointer_cast<FileNode>(node);
+        if (verifyOnRead && !file->verify())
+            throw std::runtime_error("Checksum mismatch in " + path);
+        noteRead(*file);
+        return file->readAll();
+    }
+
+    std::vector<std::string> ls(const std::string &path) { return ls(Credentials::root(), path); }
+
+    std::vector<std::string> ls(const Credentials &cred, const std::string &path)
+    {
+        std::shared_lock lock(treeMutex);
+        auto node = traverseNode(path, cred);
+        if (node->type == NodeType::File)
+            return {node->name};
+        requireAccess(*node, cred, MayRead, path);
+        auto dir = std::static_pointer_cast<DirectoryNode>(node);
+        return dir->listNames();
+    }
+
+    void rm(const std::string &path, bool recursive = false) { rm(Credentials::root(), path, recursive); }
+
+    void rm(const Credentials &cred, const std::string &path, bool recursive = false)
+    {
+        std::unique_lock lock(treeMutex);
+        detachNode(path, recursive, cred);
+    }
+
+    void mv(const std::string &src, const std::string &dest) { mv(Credentials::root(), src, dest); }
+
+    void mv(const Credentials &cred, const std::string &src, const std::string &dest)
+    {
+        if (src == "/")
+            throw std::runtime_error("Cannot move root");
+        std::unique_lock lock(treeMutex);
+        auto [srcParent, srcName] = resolveParent(src, cred, MayWrite);
+        auto node = srcParent->getChild(srcName);
+        if (!node)
+            throw std::runtime_error("Src not found");
+        if (node->type == NodeType::Directory)
+            accessGeneration++;
+
+        try
+        {
+            auto destNode = traverseNode(dest, cred);
+            if (destNode->type == NodeType::Directory)
+            {
+                auto destDir = std::static_pointer_cast<DirectoryNode>(destNode);
+                requireAccess(*destDir, cred, MayWrite, dest);
+                if (destDir->hasChild(srcName))
+                    throw std::runtime_error("Target with same name exists in destination");
+                srcParent->removeChild(srcName);
+                destDir->addChild(srcName, node);
+                node->name = srcName;
+                noteUnlinked(src, *node);
+                noteLinked(dest + "/" + srcName, *node);
+                return;
+            }
+            else
+            {
+                // dest is file -> replace file
+                auto [destParent, destName] = resolveParent(dest, cred, MayWrite);
+                destParent->removeChild(destName);
+                srcParent->removeChild(srcName);
+                node->name = destName;
+                destParent->addChild(destName, node);
+                noteUnlinked(src, *node);
+                noteUnlinked(dest, *destNode);
+                noteLinked(dest, *node);
+                return;
+            }
+        }
+        catch (const PermissionDenied &)
+        {
+            throw;
+        }
+        catch (const std::runtime_error &e)
+        {
+            // dest does not exist
+            auto [destParent, destName] = resolveParent(dest, cred, MayWrite);
+            if (destParent->hasChild(destName))
+                throw std::runtime_error("Destination exists");
+            srcParent->removeChild(srcName);
+            node->name = destName;
+            destParent->addChild(destName, node);
+            noteUnlinked(src, *node);
+            noteLinked(dest, *node);
+            return;
+        }
+    }
+
+    void cp(const std::string &src, const std::string &dest) { cp(Credentials::root(), src, dest); }
+
+    void cp(const Credentials &cred, const std::string &src, const std::string &dest)
+    {
+        std::vector<std::shared_ptr<INode>> evicted; // freed after the lock is released
+        std::unique_lock lock(treeMutex);
+        auto node = traverseNode(src, cred, MayRead);
+        placeCopy(node->name, dest, [&]
+                  { return deepCopyNode(node); }, cred);
+        enforceCacheLimit(nullptr, evicted);
+    }
+
+    // Only root and the owner may change permissions
+    void chmod(const Credentials &cred, const std::string &path, Permissions perms)
+    {
+        std::unique_lock lock(treeMutex);
+        auto node = traverseNode(path, cred);
+        if (!cred.isRoot() && cred.uid != node->uid)
+            throw PermissionDenied(path);
+        node->setPerms(perms);
+        if (node->type == NodeType::Directory)
+            accessGeneration++;
+    }
+
+    void chmod(const std::string &path, Permissions perms) { chmod(Credentials::root(), path, perms); }
+
+    // Only root may change ownership
+    void chown(const Credentials &cred, const std::string &path, uint32_t uid, uint32_t gid)
+    {
+        std::unique_lock lock(treeMutex);
+        auto node = traverseNode(path, cred);
+        if (!cred.isRoot())
+            throw PermissionDenied(path);
+        node->uid = uid;
+        node->gid = gid;
+        if (node->type == NodeType::Directory)
+            accessGeneration++;
+    }
+
+    void chown(const std::string &path, uint32_t uid, uint32_t gid) { chown(Credentials::root(), path, uid, gid); }
+
+    // NUMA placement for everything below path from now on: new nodes, file
+    // growth and directory tables. With migrate, existing file contents are
+    // copied to the new placement too; otherwise they stay where they are.
+    // Does nothing useful on a single node machine.
+    void setPlacement(const std::string &path, NumaPlacement placement, bool migrate = false)
+    {
+        std::unique_lock lock(treeMutex);
+        BufferAllocator::PlacementScope scope(placement);
+        std::vector<INode *> stack{traverseNode(path).get()};
+        while (!stack.empty())
+        {
+            INode *node = stack.back();
+            stack.pop_back();
+            node->placement = placement;
+            if (node->type == NodeType::Directory)
+            {
+                static_cast<DirectoryNode *>(node)->children.forEach(
+                    [&](const std::string &, const std::shared_ptr<INode> &child)
+                    { stack.push_back(child.get()); });
+            }
+            else if (migrate)
+            {
+                auto &data = static_cast<FileNode *>(node)->data;
+                FileData moved(data);
+                data.swap(moved);
+            }
+        }
+    }
+
+    // Split the directory at path into `shards` independently locked tables
+    // (a power of two, at most 1024; 1 undoes it). mkdir and touch in a
+    // sharded directory run under the shared tree lock, so creates from
+    // several threads proceed in parallel.
+    void shardDirectory(const std::string &path, size_t shards)
+    {
+        std::unique_lock lock(treeMutex);
+        auto node = traverseNode(path);
+        if (node->type != NodeType::Directory)
+            throw std::runtime_error(path + " is not a directory");
+        std::static_pointer_cast<DirectoryNode>(node)->children.shard(shards, concurrentDirs);
+    }
+
+    // Give the directory at path a lock-free table: lookups never wait and
+    // growth is incremental, so huge directories grow without pauses.
+    // mkdir and touch into it run under the shared tree lock, as with
+    // shardDirectory. shardDirectory(path, 1) goes back to a single map.
+    void makeDirectoryLockFree(const std::string &path)
+    {
+        std::unique_lock lock(treeMutex);
+        auto node = traverseNode(path);
+        if (node->type != NodeType::Directory)
+            throw std::runtime_error(path + " is not a directory");
+        std::static_pointer_cast<DirectoryNode>(node)->children.makeLockFree(concurrentDirs);
+    }
+
+    NumaPlacement placement(const std::string &path)
+    {
+        std::shared_lock lock(treeMutex);
+        return traverseNode(path)->placement;
+    }
+
+    // Total bytes stored in files at or below path
+    size_t du(const std::string &path)
+    {
+        std::shared_lock lock(treeMutex);
+        return diskUsage(traverseNode(path));
+    }
+
+    // Sorted paths at or below path whose name matches a '*'/'?' pattern
+    std::vector<std::string> find(const std::string &path, const std::string &pattern = "*")
+    {
+        std::shared_lock lock(treeMutex);
+        std::vector<std::string> out;
+        std::string scratch;
+        findNodes(traverseNode(path), canonicalPath(path, scratch), pattern, out);
+        sort(out.begin(), out.end());
+        return out;
+    }
+
+    // Extended attributes; names are 1 to 255 bytes, values arbitrary bytes
+    void setxattr(const std::string &path, const std::string &name, const std::string &value)
+    {
+        setxattr(Credentials::root(), path, name, value);
+    }
+
+    void setxattr(const Credentials &cred, const std::string &path, const std::string &name, const std::string &value)
+    {
+        std::unique_lock lock(treeMutex);
+        traverseNode(path, cred, MayWrite)->xattrs.set(name, value);
+    }
+
+    std::string getxattr(const std::string &path, const std::string &name)
+    {
+        return getxattr(Credentials::root(), path, name);
+    }
+
+    std::string getxattr(const Credentials &cred, const std::string &path, const std::string &name)
+    {
+        std::shared_lock lock(treeMutex);
+        auto value = traverseNode(path, cred, MayRead)->xattrs.get(name);
+        if (!value)
+            throw std::runtime_error("No attribute " + name + " on " + path);
+        return std::string(*value);
+    }
+
+    std::vector<std::string> listxattr(const std::string &path) { return listxattr(Credentials::root(), path); }
+
+    std::vector<std::string> listxattr(const Credentials &cred, const std::string &path)
+    {
+        std::shared_lock lock(treeMutex);
+        return traverseNode(path, cred, MayRead)->xattrs.names();
+    }
+
+    void removexattr(const std::string &path, const std::string &name)
+    {
+        removexattr(Credentials::root(), path, name);
+    }
+
+    void removexattr(const Credentials &cred, const std::string &path, const std::string &name)
+    {
+        std::unique_lock lock(treeMutex);
+        if (!traverseNode(path, cred, MayWrite)->xattrs.remove(name))
+            throw std::runtime_error("No attribute " + name + " on " + path);
+    }
+
+    void printTree(const std::string &path = "/", int depth = 0)
+    {
+        printTree(std::cout, path, depth);
+    }
+
+    void printTree(std::ostream &out, const std::string &path = "/", int depth = 0)
+    {
+        std::shared_lock lock(treeMutex);
+        printTreeNode(out, traverseNode(path), depth);
+    }
+};
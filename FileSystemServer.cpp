@@ -0,0 +1,31 @@
+#include "IpcServer.h"
+
+#include <csignal>
+
+/* -------------------- Main -------------------- */
+
+// usage: FileSystemServer [socketPath] [workers]
+int main(int argc, char **argv)
+{
+    ServerOptions opts;
+    if (argc > 1)
+        opts.socketPath = argv[1];
+    if (argc > 2)
+        opts.workers = std::stoul(argv[2]);
+
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigs, nullptr); // workers inherit the mask
+
+    FileSystem fs;
+    FileSystemServer server(fs, opts);
+    server.start();
+    std::cout << "serving on " << opts.socketPath << " with " << opts.workers << " workers" << std::endl;
+
+    int sig;
+    sigwait(&sigs, &sig);
+    server.stop();
+    return 0;
+}
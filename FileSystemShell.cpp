@@ -0,0 +1,327 @@
+#include "FileSystem.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+/* -------------------- Command parsing -------------------- */
+
+// A command line split into words. Words may be "double quoted" and quoted
+// words understand \n, \t, \" and \\ so file contents can be written inline.
+static std::vector<std::string> tokenize(const std::string &line)
+{
+    std::vector<std::string> words;
+    size_t i = 0;
+    while (i < line.size())
+    {
+        while (i < line.size() && isspace((unsigned char)line[i]))
+            i++;
+        if (i >= line.size() || line[i] == '#')
+            break;
+        std::string w;
+        if (line[i] == '"')
+        {
+            for (i++; i < line.size() && line[i] != '"'; i++)
+            {
+                if (line[i] == '\\' && i + 1 < line.size())
+                {
+                    char c = line[++i];
+                    w.push_back(c == 'n' ? '\n' : c == 't' ? '\t'
+                                                           : c);
+                }
+                else
+                {
+                    w.push_back(line[i]);
+                }
+            }
+            if (i >= line.size())
+                throw std::runtime_error("Unterminated quote");
+            i++;
+        }
+        else
+        {
+            while (i < line.size() && !isspace((unsigned char)line[i]))
+                w.push_back(line[i++]);
+        }
+        words.push_back(std::move(w));
+    }
+    return words;
+}
+
+/* -------------------- Shell -------------------- */
+
+class Shell
+{
+private:
+    FileSystem fs;
+    bool timing = true;
+    bool quit = false;
+    size_t errors = 0;
+
+    static void need(const std::vector<std::string> &a, size_t n, const char *usage)
+    {
+        if (a.size() < n)
+            throw std::runtime_error(std::string("usage: ") + usage);
+    }
+
+    static std::string arg(const std::vector<std::string> &a, size_t i, const char *def)
+    {
+        return i < a.size() ? a[i] : def;
+    }
+
+    static void putList(std::string &out, const std::vector<std::string> &items, char sep)
+    {
+        for (auto &s : items)
+        {
+            out += s;
+            out.push_back(sep);
+        }
+        if (sep != '\n')
+            out.push_back('\n');
+    }
+
+    // Replace every {i} in the words with the iteration number
+    static std::vector<std::string> substitute(const std::vector<std::string> &words, size_t i)
+    {
+        auto out = words;
+        std::string n = std::to_string(i);
+        for (auto &w : out)
+            for (size_t pos; (pos = w.find("{i}")) != std::string::npos;)
+                w.replace(pos, 3, n);
+        return out;
+    }
+
+    void dispatch(const std::vector<std::string> &a, std::string &out)
+    {
+        const std::string &cmd = a[0];
+        if (cmd == "mkdir")
+        {
+            bool parents = a.size() > 2 && a[1] == "-p";
+            need(a, parents ? 3 : 2, "mkdir [-p] PATH");
+            if (parents)
+                fs.mkdirs(a[2]);
+            else
+                fs.mkdir(a[1]);
+        }
+        else if (cmd == "touch")
+        {
+            need(a, 2, "touch PATH");
+            fs.touch(a[1]);
+        }
+        else if (cmd == "write" || cmd == "append")
+        {
+            need(a, 3, "write|append PATH TEXT");
+            if (cmd == "write")
+                fs.write(a[1], a[2]);
+            else
+                fs.append(a[1], a[2]);
+        }
+        else if (cmd == "cat")
+        {
+            need(a, 2, "cat PATH");
+            out += fs.read(a[1]);
+            if (out.empty() || out.back() != '\n')
+                out.push_back('\n');
+        }
+        else if (cmd == "ls")
+        {
+            putList(out, fs.ls(arg(a, 1, "/")), ' ');
+        }
+        else if (cmd == "rm")
+        {
+            bool recursive = a.size() > 2 && a[1] == "-r";
+            need(a, recursive ? 3 : 2, "rm [-r] PATH");
+            fs.rm(a[recursive ? 2 : 1], recursive);
+        }
+        else if (cmd == "mv" || cmd == "cp")
+        {
+            need(a, 3, "mv|cp SRC DEST");
+            if (cmd == "mv")
+                fs.mv(a[1], a[2]);
+            else
+                fs.cp(a[1], a[2]);
+        }
+        else if (cmd == "tree")
+        {
+            std::ostringstream tree;
+            fs.printTree(tree, arg(a, 1, "/"));
+            out += tree.str();
+        }
+        else if (cmd == "du")
+        {
+            out += std::to_string(fs.du(arg(a, 1, "/"))) + "\n";
+        }
+        else if (cmd == "find")
+        {
+            putList(out, fs.find(arg(a, 1, "/"), arg(a, 2, "*")), '\n');
+        }
+        else if (cmd == "setxattr")
+        {
+            need(a, 4, "setxattr PATH NAME VALUE");
+            fs.setxattr(a[1], a[2], a[3]);
+        }
+        else if (cmd == "getxattr")
+        {
+            need(a, 3, "getxattr PATH NAME");
+            out += fs.getxattr(a[1], a[2]) + "\n";
+        }
+        else if (cmd == "listxattr")
+        {
+            need(a, 2, "listxattr PATH");
+            putList(out, fs.listxattr(a[1]), '\n');
+        }
+        else if (cmd == "rmxattr")
+        {
+            need(a, 3, "rmxattr PATH NAME");
+            fs.removexattr(a[1], a[2]);
+        }
+        else if (cmd == "echo")
+        {
+            for (size_t i = 1; i < a.size(); i++)
+                out += a[i] + (i + 1 < a.size() ? " " : "");
+            out.push_back('\n');
+        }
+        else if (cmd == "timing")
+        {
+            need(a, 2, "timing on|off");
+            timing = a[1] == "on";
+        }
+        else if (cmd == "exit" || cmd == "quit")
+        {
+            quit = true;
+        }
+        else if (cmd == "help")
+        {
+            out += "mkdir [-p] touch write append cat ls rm [-r] mv cp tree du find echo\n"
+                   "setxattr getxattr listxattr rmxattr\n"
+                   "timing on|off    print the time taken by each command\n"
+                   "repeat N CMD...  run CMD N times, {i} expands to the iteration\n"
+                   "exit\n";
+        }
+        else
+        {
+            throw std::runtime_error("unknown command: " + cmd);
+        }
+    }
+
+public:
+    // Run one command line, appending its output (and timing) to out
+    void execute(const std::string &line, std::string &out)
+    {
+        std::vector<std::string> words;
+        try
+        {
+            words = tokenize(line);
+        }
+        catch (const std::exception &e)
+        {
+            out += std::string("error: ") + e.what() + "\n";
+            errors++;
+            return;
+        }
+        if (words.empty())
+            return;
+
+        auto start = std::chrono::steady_clock::now();
+        size_t runs = 1;
+        try
+        {
+            if (words[0] == "repeat")
+            {
+                need(words, 3, "repeat N CMD...");
+                runs = std::stoul(words[1]);
+                std::vector<std::string> body(words.begin() + 2, words.end());
+                for (size_t i = 0; i < runs && !quit; i++)
+                    dispatch(substitute(body, i), out);
+            }
+            else
+            {
+                dispatch(words, out);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            out += std::string("error: ") + e.what() + "\n";
+            errors++;
+        }
+        if (timing)
+        {
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            char buf[96];
+            if (runs > 1)
+                snprintf(buf, sizeof(buf), "[%.3f us total, %.3f us/op] ", us, us / runs);
+            else
+                snprintf(buf, sizeof(buf), "[%.3f us] ", us);
+            out += buf + line + "\n";
+        }
+    }
+
+    // Read everything from in, then execute it in batches of batchSize commands,
+    // writing each batch's output in one go
+    void runBatch(std::istream &in, size_t batchSize = 4096)
+    {
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(in, line);)
+            lines.push_back(std::move(line));
+
+        std::string out;
+        for (size_t i = 0; i < lines.size() && !quit; i += batchSize)
+        {
+            out.clear();
+            for (size_t j = i; j < std::min(lines.size(), i + batchSize) && !quit; j++)
+                execute(lines[j], out);
+            std::cout << out;
+        }
+        std::cout.flush();
+    }
+
+    void runInteractive()
+    {
+        std::string line, out;
+        while (!quit && (std::cout << "fs> ").flush() && std::getline(std::cin, line))
+        {
+            out.clear();
+            execute(line, out);
+            std::cout << out;
+        }
+    }
+
+    size_t errorCount() const { return errors; }
+};
+
+/* -------------------- Main -------------------- */
+
+// usage: FileSystemShell [script]   (reads stdin when no script is given)
+int main(int argc, char **argv)
+{
+    std::ios::sync_with_stdio(false);
+
+    Shell shell;
+    if (argc > 1)
+    {
+        std::ifstream script(argv[1]);
+        if (!script)
+        {
+            std::cerr << "cannot open " << argv[1] << "\n";
+            return 1;
+        }
+        shell.runBatch(script);
+    }
+    else if (isatty(fileno(stdin)))
+    {
+        shell.runInteractive();
+    }
+    else
+    {
+        shell.runBatch(std::cin);
+    }
+    return shell.errorCount() ? 1 : 0;
+}
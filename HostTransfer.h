@@ -0,0 +1,345 @@
+#pragma once
+
+#include "FileSystem.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+/* -------------------- HostTransfer -------------------- */
+
+struct HostTransferOptions
+{
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    // Import only: spread top-level directories over the NUMA nodes
+    // round-robin, bind each one's subtree to its node and pin workers to
+    // nodes, each preferring directories of its own node. No effect on a
+    // single node machine.
+    bool numaAffinity = false;
+};
+
+struct HostTransferStats
+{
+    size_t files = 0;
+    size_t dirs = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+
+    double filesPerSec() const { return seconds > 0 ? files / seconds : 0; }
+    double mbPerSec() const { return seconds > 0 ? bytes / seconds / (1 << 20) : 0; }
+};
+
+// Copies trees between the host file system and a FileSystem.
+//
+// importFromHost scans host directories in parallel: each worker takes a
+// directory off a shared queue, creates nodes for its entries directly under
+// the matching DirectoryNode (no path resolution from the root) and queues
+// subdirectories. File contents are read in one call into a buffer sized from
+// the directory entry. The new subtree is linked into the file system at the end.
+//
+// exportToHost snapshots the subtree's shape under a read lock, creates the
+// host directories, then writes files from several threads.
+class HostTransfer
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct ScanItem
+    {
+        std::filesystem::path hostDir;
+        std::shared_ptr<DirectoryNode> dir;
+        unsigned node = 0; // NUMA node the subtree is bound to, with numaAffinity
+        bool top = false;  // the directory being imported
+    };
+
+    // Directory work queue that knows when the scan is complete: once it is
+    // empty and no worker is still listing a directory. Items are kept per
+    // NUMA node; a worker takes from its own node first and steals otherwise.
+    class ScanQueue
+    {
+    private:
+        std::mutex m;
+        std::condition_variable cv;
+        std::vector<std::deque<ScanItem>> items;
+        size_t queued = 0;
+        size_t active = 0;
+        bool failed = false;
+
+    public:
+        explicit ScanQueue(unsigned nodes) : items(nodes) {}
+
+        void push(ScanItem item)
+        {
+            std::lock_guard lock(m);
+            items[item.node % items.size()].push_back(std::move(item));
+            queued++;
+            cv.notify_one();
+        }
+
+        bool pop(ScanItem &item, unsigned node)
+        {
+            std::unique_lock lock(m);
+            cv.wait(lock, [&]
+                    { return failed || queued || active == 0; });
+            if (failed || !queued)
+                return false;
+            for (size_t k = 0; k < items.size(); k++)
+            {
+                auto &q = items[(node + k) % items.size()];
+                if (!q.empty())
+                {
+                    item = std::move(q.front());
+                    q.pop_front();
+                    break;
+                }
+            }
+            queued--;
+            active++;
+            return true;
+        }
+
+        void done()
+        {
+            std::lock_guard lock(m);
+            if (--active == 0 && !queued)
+                cv.notify_all();
+        }
+
+        void fail()
+        {
+            std::lock_guard lock(m);
+            failed = true;
+            cv.notify_all();
+        }
+    };
+
+    static void readHostFile(const std::filesystem::path &p, size_t size, FileData &data)
+    {
+        std::ifstream in(p, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Cannot open " + p.string());
+        data.resize(size);
+        size_t got = size ? (size_t)in.rdbuf()->sgetn(data.data(), size) : 0;
+        // the file may have changed since it was listed; keep what was there
+        data.resize(got);
+    }
+
+    static void setTimes(INode &node, const std::filesystem::directory_entry &entry)
+    {
+        std::error_code ec;
+        auto ft = entry.last_write_time(ec);
+        if (ec)
+            return;
+        auto sys = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+            ft - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
+        node.created = node.modified = std::chrono::system_clock::to_time_t(sys);
+    }
+
+    // With nodes > 1 the entries of the top directory are dealt out to the
+    // nodes in turn and everything else stays on its parent's node
+    static void scanDirectory(const ScanItem &item, ScanQueue &queue, unsigned nodes, std::atomic<size_t> &files,
+                              std::atomic<size_t> &dirs, std::atomic<size_t> &bytes)
+    {
+        size_t localFiles = 0, localDirs = 0, localBytes = 0;
+        unsigned next = 0;
+        for (auto &entry : std::filesystem::directory_iterator(item.hostDir))
+        {
+            std::string name = entry.path().filename().string();
+            auto status = entry.symlink_status();
+            unsigned node = item.top ? next++ % nodes : item.node;
+            BufferAllocator::PlacementScope scope(nodes > 1 ? NumaPlacement::bind(node) : BufferAllocator::placement());
+            if (std::filesystem::is_directory(status))
+            {
+                auto dir = makeNode<DirectoryNode>(name);
+                setTimes(*dir, entry);
+                item.dir->addChild(name, dir);
+                queue.push({entry.path(), dir, node});
+                localDirs++;
+            }
+            else if (std::filesystem::is_regular_file(status))
+            {
+                auto file = makeNode<FileNode>(name);
+                FileData data;
+                readHostFile(entry.path(), entry.file_size(), data);
+                file->setData(std::move(data));
+                setTimes(*file, entry);
+                localBytes += file->size();
+                item.dir->addChild(name, file);
+                localFiles++;
+            }
+            // symlinks and special files are skipped
+        }
+        files += localFiles;
+        dirs += localDirs;
+        bytes += localBytes;
+    }
+
+    struct ExportFile
+    {
+        std::filesystem::path hostPath;
+        std::shared_ptr<FileNode> file;
+    };
+
+    static void collect(const std::shared_ptr<INode> &node, const std::filesystem::path &hostPath,
+                        std::vector<std::filesystem::path> &dirs, std::vector<ExportFile> &files)
+    {
+        if (node->type == NodeType::File)
+        {
+            files.push_back({hostPath, std::static_pointer_cast<FileNode>(node)});
+            return;
+        }
+        dirs.push_back(hostPath);
+        std::static_pointer_cast<DirectoryNode>(node)->children.forEach(
+            [&](const std::string &name, const std::shared_ptr<INode> &child)
+            { collect(child, hostPath / name, dirs, files); });
+    }
+
+public:
+    // Copy the host directory hostPath into the file system. If fsPath is an
+    // existing directory the host directory's contents are added to it
+    // (failing, without changes, on name clashes); otherwise fsPath is created.
+    static HostTransferStats importFromHost(FileSystem &fs, const std::string &hostPath, const std::string &fsPath,
+                                            HostTransferOptions opts = {})
+    {
+        auto start = Clock::now();
+        if (!std::filesystem::is_directory(hostPath))
+            throw std::runtime_error(hostPath + " is not a host directory");
+
+        auto staging = makeNode<DirectoryNode>("/");
+        unsigned nodes = opts.numaAffinity ? numaNodeCount() : 1;
+        ScanQueue queue(nodes);
+        queue.push({hostPath, staging, 0, true});
+        std::atomic<size_t> files{0}, dirs{0}, bytes{0};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < std::max<size_t>(opts.workers, 1); i++)
+            threads.emplace_back([&, i]
+                                 {
+                unsigned node = (unsigned)(i % nodes);
+                if (nodes > 1)
+                    pinThreadToNumaNode(node);
+                ScanItem item;
+                while (queue.pop(item, node))
+                {
+                    try
+                    {
+                        scanDirectory(item, queue, nodes, files, dirs, bytes);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard lock(errorMutex);
+                        if (!error)
+                            error = std::current_exception();
+                        queue.fail();
+                    }
+                    queue.done();
+                } });
+        for (auto &t : threads)
+            t.join();
+        if (error)
+            std::rethrow_exception(error);
+
+        {
+            std::vector<std::shared_ptr<INode>> evicted; // freed after the lock is released
+            std::unique_lock lock(fs.treeMutex);
+            std::shared_ptr<INode> existing;
+            try
+            {
+                existing = fs.traverseNode(fsPath);
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+            if (existing)
+            {
+                if (existing->type != NodeType::Directory)
+                    throw std::runtime_error(fsPath + " is not a directory");
+                auto dir = std::static_pointer_cast<DirectoryNode>(existing);
+                staging->children.forEach([&](const std::string &name, const std::shared_ptr<INode> &)
+                                          {
+                    if (dir->hasChild(name))
+                        throw std::runtime_error(name + " already exists"); });
+                staging->children.forEach([&](const std::string &name, const std::shared_ptr<INode> &child)
+                                          {
+                    dir->addChild(name, child);
+                    fs.noteLinked(fsPath + "/" + name, *child); });
+            }
+            else
+            {
+                auto [parent, name] = fs.resolveParent(fsPath);
+                staging->name = name;
+                parent->addChild(name, staging);
+                fs.noteLinked(fsPath, *staging);
+            }
+            fs.enforceCacheLimit(nullptr, evicted);
+        }
+
+        HostTransferStats stats;
+        stats.files = files;
+        stats.dirs = dirs;
+        stats.bytes = bytes;
+        stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return stats;
+    }
+
+    // Write the subtree at fsPath to hostPath (created if missing; existing
+    // files are overwritten)
+    static HostTransferStats exportToHost(FileSystem &fs, const std::string &fsPath, const std::string &hostPath,
+                                          HostTransferOptions opts = {})
+    {
+        auto start = Clock::now();
+        std::vector<std::filesystem::path> dirs;
+        std::vector<ExportFile> files;
+        {
+            std::shared_lock lock(fs.treeMutex);
+            collect(fs.traverseNode(fsPath), hostPath, dirs, files);
+        }
+        for (auto &d : dirs)
+            std::filesystem::create_directories(d);
+
+        std::atomic<size_t> next{0}, bytes{0};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < std::max<size_t>(opts.workers, 1); i++)
+            threads.emplace_back([&]
+                                 {
+                try
+                {
+                    for (size_t k; (k = next++) < files.size();)
+                    {
+                        std::ofstream out(files[k].hostPath, std::ios::binary | std::ios::trunc);
+                        std::shared_lock lock(fs.treeMutex);
+                        auto &data = files[k].file->data;
+                        out.write(data.data(), data.size());
+                        bytes += data.size();
+                        if (!out)
+                            throw std::runtime_error("Failed to write " + files[k].hostPath.string());
+                    }
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    next = files.size();
+                } });
+        for (auto &t : threads)
+            t.join();
+        if (error)
+            std::rethrow_exception(error);
+
+        HostTransferStats stats;
+        stats.files = files.size();
+        stats.dirs = dirs.size();
+        stats.bytes = bytes;
+        stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return stats;
+    }
+};
@@ -0,0 +1,228 @@
+#pragma once
+
+#if !defined(__linux__)
+#error "IpcClient.h needs Linux (Unix domain sockets)"
+#endif
+
+#include "IpcProtocol.h"
+
+#include <cerrno>
+#include <initializer_list>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* -------------------- FileSystemClient -------------------- */
+
+struct Response
+{
+    uint32_t id = 0;
+    Status status = Status::Ok;
+    std::string payload; // fields after the header, decoded by the helpers below
+
+    std::string error() const { return status == Status::Error ? firstString() : ""; }
+
+    std::string firstString() const
+    {
+        if (payload.size() < 4)
+            return "";
+        uint32_t len;
+        memcpy(&len, payload.data(), 4);
+        return payload.substr(4, len);
+    }
+
+    uint64_t firstU64() const
+    {
+        uint64_t v = 0;
+        if (payload.size() >= 8)
+            memcpy(&v, payload.data(), 8);
+        return v;
+    }
+
+    std::vector<std::string> stringList() const
+    {
+        std::vector<std::string> out;
+        const char *p = payload.data();
+        uint32_t count;
+        memcpy(&count, p, 4);
+        p += 4;
+        out.reserve(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t len;
+            memcpy(&len, p, 4);
+            out.emplace_back(p + 4, len);
+            p += 4 + len;
+        }
+        return out;
+    }
+};
+
+// Talks to a FileSystemServer over one connection. The blocking helpers
+// (mkdir, read, ...) mirror FileSystem and throw on errors; for pipelining
+// queue requests with send(), push them out with flush() and collect the
+// answers, in order, with receive().
+class FileSystemClient
+{
+private:
+    int fd = -1;
+    uint32_t nextId = 1;
+    std::string outBuf;
+    std::string inBuf;
+    size_t inPos = 0;
+
+    static void throwErrno(const std::string &what)
+    {
+        throw std::runtime_error(what + ": " + strerror(errno));
+    }
+
+    Response call(Op op, uint8_t flags, std::string_view a, std::string_view b = {}, bool hasB = false)
+    {
+        send(op, flags, a, b, hasB);
+        return finishCall();
+    }
+
+    Response call(Op op, std::initializer_list<std::string_view> fields)
+    {
+        send(op, 0, fields);
+        return finishCall();
+    }
+
+    Response finishCall()
+    {
+        flush();
+        Response r = receive();
+        if (r.status == Status::Error)
+            throw std::runtime_error(r.error());
+        return r;
+    }
+
+public:
+    explicit FileSystemClient(const std::string &socketPath)
+    {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            throwErrno("socket");
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("Socket path too long");
+        strcpy(addr.sun_path, socketPath.c_str());
+        if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            close(fd);
+            throwErrno("connect " + socketPath);
+        }
+    }
+
+    FileSystemClient(const FileSystemClient &) = delete;
+    FileSystemClient &operator=(const FileSystemClient &) = delete;
+
+    ~FileSystemClient()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    // Queue a request without sending it; returns its id
+    uint32_t send(Op op, uint8_t flags, std::string_view a, std::string_view b = {}, bool hasB = false)
+    {
+        uint32_t id = nextId++;
+        FrameWriter w(outBuf, id, (uint8_t)op, flags);
+        w.putString(a);
+        if (hasB)
+            w.putString(b);
+        w.finish();
+        return id;
+    }
+
+    // send() for requests with any number of string fields
+    uint32_t send(Op op, uint8_t flags, std::initializer_list<std::string_view> fields)
+    {
+        uint32_t id = nextId++;
+        FrameWriter w(outBuf, id, (uint8_t)op, flags);
+        for (auto f : fields)
+            w.putString(f);
+        w.finish();
+        return id;
+    }
+
+    void flush()
+    {
+        size_t off = 0;
+        while (off < outBuf.size())
+        {
+            ssize_t n = ::send(fd, outBuf.data() + off, outBuf.size() - off, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throwErrno("send");
+            }
+            off += n;
+        }
+        outBuf.clear();
+    }
+
+    // Next response, in request order
+    Response receive()
+    {
+        while (true)
+        {
+            if (size_t size = completeFrameSize(inBuf.data() + inPos, inBuf.size() - inPos))
+            {
+                FrameReader r(inBuf.data() + inPos, size);
+                Response resp;
+                resp.id = r.header.id;
+                resp.status = (Status)r.header.code;
+                resp.payload.assign(inBuf.data() + inPos + FrameHeaderSize, size - FrameHeaderSize);
+                inPos += size;
+                if (inPos == inBuf.size())
+                {
+                    inBuf.clear();
+                    inPos = 0;
+                }
+                return resp;
+            }
+            if (inPos > 0)
+            {
+                inBuf.erase(0, inPos);
+                inPos = 0;
+            }
+            char buf[64 * 1024];
+            ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                throw std::runtime_error("Connection closed by server");
+            inBuf.append(buf, n);
+        }
+    }
+
+    void mkdir(const std::string &path) { call(Op::Mkdir, 0, path); }
+    void touch(const std::string &path) { call(Op::Touch, 0, path); }
+    void write(const std::string &path, const std::string &content) { call(Op::Write, 0, path, content, true); }
+    void append(const std::string &path, const std::string &content) { call(Op::Append, 0, path, content, true); }
+    std::string read(const std::string &path) { return call(Op::Read, 0, path).firstString(); }
+    std::vector<std::string> ls(const std::string &path) { return call(Op::Ls, 0, path).stringList(); }
+    void rm(const std::string &path, bool recursive = false) { call(Op::Rm, recursive ? RecursiveFlag : 0, path); }
+    void mv(const std::string &src, const std::string &dest) { call(Op::Mv, 0, src, dest, true); }
+    void cp(const std::string &src, const std::string &dest) { call(Op::Cp, 0, src, dest, true); }
+    std::string tree(const std::string &path = "/") { return call(Op::Tree, 0, path).firstString(); }
+    void mkdirs(const std::string &path) { call(Op::Mkdirs, 0, path); }
+    size_t du(const std::string &path) { return call(Op::Du, 0, path).firstU64(); }
+    std::vector<std::string> find(const std::string &path, const std::string &pattern = "*")
+    {
+        return call(Op::Find, 0, path, pattern, true).stringList();
+    }
+    void setxattr(const std::string &path, const std::string &name, const std::string &value)
+    {
+        call(Op::SetXattr, {path, name, value});
+    }
+    std::string getxattr(const std::string &path, const std::string &name)
+    {
+        return call(Op::GetXattr, 0, path, name, true).firstString();
+    }
+    std::vector<std::string> listxattr(const std::string &path) { return call(Op::ListXattr, 0, path).stringList(); }
+    void removexattr(const std::string &path, const std::string &name) { call(Op::RemoveXattr, 0, path, name, true); }
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* -------------------- Wire format -------------------- */
+
+// Every frame is [u32 bodyLen][u32 requestId][u8 code][u8 flags][fields...],
+// integers in host byte order (both ends live on the same machine) and
+// strings as [u32 len][bytes]. For requests code is an Op, for responses a
+// Status; an error response carries the message as its only field.
+// Responses on a connection come back in request order, so clients can keep
+// many requests in flight and match them up by id.
+
+enum class Op : uint8_t
+{
+    Mkdir = 1,
+    Touch,
+    Write,
+    Append,
+    Read,
+    Ls,
+    Rm, // flags & RecursiveFlag
+    Mv,
+    Cp,
+    Tree,
+    Mkdirs,
+    Du,   // answered with a u64
+    Find, // path, pattern
+    SetXattr,
+    GetXattr,
+    ListXattr,
+    RemoveXattr,
+};
+
+enum class Status : uint8_t
+{
+    Ok = 0,
+    Error = 1,
+};
+
+constexpr uint8_t RecursiveFlag = 1;
+constexpr size_t FrameHeaderSize = 4 + 4 + 1 + 1;
+constexpr uint32_t MaxFrameBody = 1u << 30;
+
+struct FrameHeader
+{
+    uint32_t id;
+    uint8_t code;
+    uint8_t flags;
+};
+
+// Appends one frame to buf; the length prefix is patched in by finish()
+class FrameWriter
+{
+private:
+    std::string &buf;
+    size_t start;
+
+public:
+    FrameWriter(std::string &_buf, uint32_t id, uint8_t code, uint8_t flags = 0) : buf(_buf), start(_buf.size())
+    {
+        putU32(0);
+        putU32(id);
+        buf.push_back((char)code);
+        buf.push_back((char)flags);
+    }
+
+    void putU32(uint32_t v) { buf.append((const char *)&v, 4); }
+    void putU64(uint64_t v) { buf.append((const char *)&v, 8); }
+
+    void putString(std::string_view s)
+    {
+        putU32((uint32_t)s.size());
+        buf.append(s.data(), s.size());
+    }
+
+    void putStrings(const std::vector<std::string> &list)
+    {
+        putU32((uint32_t)list.size());
+        for (auto &s : list)
+            putString(s);
+    }
+
+    void finish()
+    {
+        uint32_t len = (uint32_t)(buf.size() - start - 4);
+        memcpy(&buf[start], &len, 4);
+    }
+};
+
+// Reads fields out of one complete frame without copying
+class FrameReader
+{
+private:
+    const char *p;
+    const char *end;
+
+public:
+    FrameHeader header;
+
+    FrameReader(const char *frame, size_t size) : p(frame + 4), end(frame + size)
+    {
+        memcpy(&header.id, p, 4);
+        header.code = (uint8_t)p[4];
+        header.flags = (uint8_t)p[5];
+        p += 6;
+    }
+
+    uint32_t u32()
+    {
+        if (end - p < 4)
+            throw std::runtime_error("Truncated frame");
+        uint32_t v;
+        memcpy(&v, p, 4);
+        p += 4;
+        return v;
+    }
+
+    std::string_view str()
+    {
+        uint32_t len = u32();
+        if ((size_t)(end - p) < len)
+            throw std::runtime_error("Truncated frame");
+        std::string_view s(p, len);
+        p += len;
+        return s;
+    }
+};
+
+// Size of the frame at the start of data if it has fully arrived, else 0
+inline size_t completeFrameSize(const char *data, size_t n)
+{
+    if (n < 4)
+        return 0;
+    uint32_t len;
+    memcpy(&len, data, 4);
+    if (len < FrameHeaderSize - 4 || len > MaxFrameBody)
+        throw std::runtime_error("Malformed frame length");
+    return n >= 4 + (size_t)len ? 4 + (size_t)len : 0;
+}
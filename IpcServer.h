@@ -0,0 +1,343 @@
+#pragma once
+
+#if !defined(__linux__)
+#error "IpcServer.h needs Linux (epoll, Unix domain sockets)"
+#endif
+
+#include "FileSystem.h"
+#include "IpcProtocol.h"
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* -------------------- FileSystemServer -------------------- */
+
+struct ServerOptions
+{
+    std::string socketPath = "/tmp/inmemfs.sock";
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    size_t maxFrameBytes = 64u << 20;  // longer requests drop the connection
+    size_t maxQueuedReply = 4u << 20; // unsent reply bytes at which a connection stops being read
+};
+
+// Serves one FileSystem over a Unix domain socket. Each worker thread owns an
+// epoll instance; all of them watch the listening socket (EPOLLEXCLUSIVE) so a
+// connection lives on whichever worker accepted it. Every readable event drains
+// the socket, executes all complete frames in order and answers them with a
+// single write, which is what makes pipelining pay off. A client that
+// pipelines faster than it reads its replies is not read from while
+// opts.maxQueuedReply bytes wait for it, so neither buffer grows unbounded.
+class FileSystemServer
+{
+private:
+    struct Connection
+    {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t outOffset = 0;
+        uint32_t events = EPOLLIN; // what epoll watches for
+    };
+
+    FileSystem &fs;
+    ServerOptions opts;
+    int listenFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> stopping{false};
+    std::vector<std::thread> threads;
+
+    static void throwErrno(const std::string &what)
+    {
+        throw std::runtime_error(what + ": " + strerror(errno));
+    }
+
+    void execute(FrameReader &req, std::string &out)
+    {
+        auto op = (Op)req.header.code;
+        size_t start = out.size();
+        FrameWriter resp(out, req.header.id, (uint8_t)Status::Ok);
+        try
+        {
+            std::string path(req.str());
+            switch (op)
+            {
+            case Op::Mkdir:
+                fs.mkdir(path);
+                break;
+            case Op::Touch:
+                fs.touch(path);
+                break;
+            case Op::Write:
+                fs.write(path, std::string(req.str()));
+                break;
+            case Op::Append:
+                fs.append(path, std::string(req.str()));
+                break;
+            case Op::Read:
+                resp.putString(fs.read(path));
+                break;
+            case Op::Ls:
+                resp.putStrings(fs.ls(path));
+                break;
+            case Op::Rm:
+                fs.rm(path, req.header.flags & RecursiveFlag);
+                break;
+            case Op::Mv:
+                fs.mv(path, std::string(req.str()));
+                break;
+            case Op::Cp:
+                fs.cp(path, std::string(req.str()));
+                break;
+            case Op::Tree:
+            {
+                std::ostringstream tree;
+                fs.printTree(tree, path);
+                resp.putString(tree.str());
+                break;
+            }
+            case Op::Mkdirs:
+                fs.mkdirs(path);
+                break;
+            case Op::Du:
+                resp.putU64(fs.du(path));
+                break;
+            case Op::Find:
+                resp.putStrings(fs.find(path, std::string(req.str())));
+                break;
+            case Op::SetXattr:
+            {
+                std::string name(req.str());
+                fs.setxattr(path, name, std::string(req.str()));
+                break;
+            }
+            case Op::GetXattr:
+                resp.putString(fs.getxattr(path, std::string(req.str())));
+                break;
+            case Op::ListXattr:
+                resp.putStrings(fs.listxattr(path));
+                break;
+            case Op::RemoveXattr:
+                fs.removexattr(path, std::string(req.str()));
+                break;
+            default:
+                throw std::runtime_error("Unknown op");
+            }
+            resp.finish();
+        }
+        catch (const std::exception &e)
+        {
+            // drop the partial ok frame and answer with an error instead
+            out.resize(start);
+            FrameWriter err(out, req.header.id, (uint8_t)Status::Error);
+            err.putString(e.what());
+            err.finish();
+        }
+    }
+
+    size_t queuedReply(const Connection &c) const { return c.out.size() - c.outOffset; }
+
+    bool onReadable(Connection &c)
+    {
+        char buf[64 * 1024];
+        // a frame never needs more than maxFrameBytes buffered; the rest
+        // stays in the socket until these are served
+        while (c.in.size() < opts.maxFrameBytes)
+        {
+            ssize_t n = ::read(c.fd, buf, sizeof(buf));
+            if (n > 0)
+            {
+                c.in.append(buf, n);
+                continue;
+            }
+            if (n == 0)
+                return false;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        return serve(c);
+    }
+
+    // Execute the complete frames in c.in, in order, until the replies
+    // waiting to go out reach opts.maxQueuedReply, then send what can be
+    // sent. False if the client is to be dropped.
+    bool serve(Connection &c)
+    {
+        size_t pos = 0;
+        try
+        {
+            while (queuedReply(c) < opts.maxQueuedReply && c.in.size() - pos >= 4)
+            {
+                uint32_t len;
+                memcpy(&len, c.in.data() + pos, 4);
+                if (4 + (size_t)len > opts.maxFrameBytes)
+                    return false;
+                size_t size = completeFrameSize(c.in.data() + pos, c.in.size() - pos);
+                if (!size)
+                    break;
+                FrameReader req(c.in.data() + pos, size);
+                execute(req, c.out);
+                pos += size;
+            }
+        }
+        catch (const std::exception &)
+        {
+            return false; // framing is broken, drop the client
+        }
+        c.in.erase(0, pos);
+        return flush(c);
+    }
+
+    bool flush(Connection &c)
+    {
+        while (c.outOffset < c.out.size())
+        {
+            ssize_t n = ::send(c.fd, c.out.data() + c.outOffset, c.out.size() - c.outOffset, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                c.outOffset += n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return true;
+            return false;
+        }
+        c.out.clear();
+        c.outOffset = 0;
+        return true;
+    }
+
+    void workerLoop()
+    {
+        int ep = epoll_create1(EPOLL_CLOEXEC);
+        if (ep < 0)
+            throwErrno("epoll_create1");
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = nullptr;
+        epoll_ctl(ep, EPOLL_CTL_ADD, listenFd, &ev);
+        ev.events = EPOLLIN;
+        ev.data.ptr = &wakeFd;
+        epoll_ctl(ep, EPOLL_CTL_ADD, wakeFd, &ev);
+
+        std::unordered_map<int, std::unique_ptr<Connection>> conns;
+        epoll_event events[128];
+        while (!stopping.load(std::memory_order_relaxed))
+        {
+            int n = epoll_wait(ep, events, 128, -1);
+            for (int i = 0; i < n; i++)
+            {
+                if (events[i].data.ptr == nullptr)
+                {
+                    int fd;
+                    while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                    {
+                        auto c = std::make_unique<Connection>();
+                        c->fd = fd;
+                        epoll_event cev{};
+                        cev.events = EPOLLIN;
+                        cev.data.ptr = c.get();
+                        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &cev);
+                        conns[fd] = std::move(c);
+                    }
+                    continue;
+                }
+                if (events[i].data.ptr == &wakeFd)
+                    continue;
+
+                auto &c = *static_cast<Connection *>(events[i].data.ptr);
+                bool ok = true;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    ok = onReadable(c);
+                if (ok && (events[i].events & EPOLLOUT))
+                    ok = flush(c) && (queuedReply(c) >= opts.maxQueuedReply || serve(c));
+                if (!ok)
+                {
+                    int fd = c.fd;
+                    epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+                    close(fd);
+                    conns.erase(fd);
+                    continue;
+                }
+                uint32_t want = (queuedReply(c) < opts.maxQueuedReply ? (uint32_t)EPOLLIN : 0u) |
+                                (c.out.empty() ? 0u : (uint32_t)EPOLLOUT);
+                if (want != c.events)
+                {
+                    epoll_event cev{};
+                    cev.events = want;
+                    cev.data.ptr = &c;
+                    epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &cev);
+                    c.events = want;
+                }
+            }
+        }
+        for (auto &p : conns)
+            close(p.first);
+        close(ep);
+    }
+
+public:
+    FileSystemServer(FileSystem &_fs, ServerOptions _opts = {}) : fs(_fs), opts(std::move(_opts)) {}
+
+    ~FileSystemServer()
+    {
+        try
+        {
+            stop();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "FileSystemServer: " << e.what() << "\n";
+        }
+    }
+
+    void start()
+    {
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0)
+            throwErrno("socket");
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (opts.socketPath.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("Socket path too long");
+        strcpy(addr.sun_path, opts.socketPath.c_str());
+        unlink(opts.socketPath.c_str());
+        if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) < 0)
+            throwErrno("bind " + opts.socketPath);
+        if (listen(listenFd, SOMAXCONN) < 0)
+            throwErrno("listen");
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        for (size_t i = 0; i < std::max<size_t>(opts.workers, 1); i++)
+            threads.emplace_back([this]
+                                 { workerLoop(); });
+    }
+
+    void stop()
+    {
+        if (threads.empty())
+            return;
+        stopping = true;
+        uint64_t one = 1;
+        if (::write(wakeFd, &one, sizeof(one)) < 0)
+            throwErrno("eventfd write");
+        for (auto &t : threads)
+            t.join();
+        threads.clear();
+        close(listenFd);
+        close(wakeFd);
+        unlink(opts.socketPath.c_str());
+    }
+};
@@ -0,0 +1,265 @@
+#pragma once
+
+#include "FileSystem.h"
+
+#include <array>
+
+/* -------------------- NodeTable -------------------- */
+
+struct ExtensionUsage
+{
+    std::string extension; // without the dot; empty for names without one
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+};
+
+// Columnar snapshot of a subtree for tree-wide analytics. Node metadata sits
+// in parallel arrays indexed by node id, so aggregates are sequential passes
+// over a few dense columns rather than walks over scattered INodes. Ids are
+// assigned in depth-first preorder: the subtree of node i is exactly the id
+// range [i, subtreeEnd[i]), so a query below any directory is a range scan.
+//
+// The table does not follow later changes to the file system; call refresh()
+// to rebuild it.
+class NodeTable
+{
+public:
+    static constexpr uint32_t NoParent = UINT32_MAX;
+    static constexpr size_t SizeBuckets = 64; // bucket 0: empty, bucket k: sizes in [2^(k-1), 2^k)
+
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> subtreeEnd;
+    std::vector<uint8_t> isFile;
+    std::vector<uint64_t> size;  // bytes, 0 for directories
+    std::vector<uint32_t> mtime; // seconds since the epoch
+    std::vector<uint32_t> ext;   // index into extensions
+    std::vector<std::string> extensions;
+
+private:
+    FileSystem &fs;
+    std::string rootPath;
+    std::vector<uint32_t> nameOffset; // names[nameOffset[i], nameOffset[i + 1])
+    std::string names;
+
+    static std::string_view extensionOf(const std::string &name)
+    {
+        size_t dot = name.rfind('.');
+        if (dot == std::string::npos || dot == 0)
+            return {};
+        return std::string_view(name).substr(dot + 1);
+    }
+
+    void build()
+    {
+        parent.clear();
+        subtreeEnd.clear();
+        isFile.clear();
+        size.clear();
+        mtime.clear();
+        ext.clear();
+        extensions.assign(1, "");
+        nameOffset.assign(1, 0);
+        names.clear();
+        std::unordered_map<std::string, uint32_t> extIds{{"", 0}};
+
+        std::shared_lock lock(fs.treeMutex);
+        // explicit stack of (node, parent id); subtreeEnd is filled in when
+        // the walk leaves a directory, marked by a null node
+        std::vector<std::pair<std::shared_ptr<INode>, uint32_t>> stack{{fs.traverseNode(rootPath), NoParent}};
+        std::vector<uint32_t> open;
+        while (!stack.empty())
+        {
+            auto [node, up] = std::move(stack.back());
+            stack.pop_back();
+            if (!node)
+            {
+                subtreeEnd[open.back()] = (uint32_t)parent.size();
+                open.pop_back();
+                continue;
+            }
+
+            uint32_t id = (uint32_t)parent.size();
+            parent.push_back(up);
+            subtreeEnd.push_back(id + 1);
+            mtime.push_back(node->modified.secs);
+            names += node->name;
+            nameOffset.push_back((uint32_t)names.size());
+            if (node->type == NodeType::File)
+            {
+                isFile.push_back(1);
+                size.push_back(static_cast<FileNode &>(*node).size());
+                auto e = extensionOf(node->name);
+                auto it = extIds.find(std::string(e));
+                if (it == extIds.end())
+                {
+                    it = extIds.emplace(std::string(e), (uint32_t)extensions.size()).first;
+                    extensions.emplace_back(e);
+                }
+                ext.push_back(it->second);
+                continue;
+            }
+            isFile.push_back(0);
+            size.push_back(0);
+            ext.push_back(0);
+            open.push_back(id);
+            stack.push_back({nullptr, 0});
+            static_cast<DirectoryNode &>(*node).children.forEach(
+                [&](const std::string &, const std::shared_ptr<INode> &child)
+                { stack.push_back({child, id}); });
+        }
+    }
+
+    std::pair<uint32_t, uint32_t> range(uint32_t id) const { return {id, subtreeEnd[id]}; }
+
+public:
+    NodeTable(FileSystem &_fs, const std::string &_rootPath = "/") : fs(_fs)
+    {
+        std::string scratch;
+        rootPath = canonicalPath(_rootPath, scratch);
+        build();
+    }
+
+    void refresh() { build(); }
+
+    size_t nodeCount() const { return parent.size(); }
+
+    std::string_view name(uint32_t id) const
+    {
+        return std::string_view(names).substr(nameOffset[id], nameOffset[id + 1] - nameOffset[id]);
+    }
+
+    // Path of node id, relative to the file system root
+    std::string path(uint32_t id) const
+    {
+        std::vector<std::string_view> parts;
+        for (uint32_t i = id; parent[i] != NoParent; i = parent[i])
+            parts.push_back(name(i));
+        std::string out = rootPath == "/" ? "" : rootPath;
+        for (auto it = parts.rbegin(); it != parts.rend(); ++it)
+            out += "/" + std::string(*it);
+        return out.empty() ? "/" : out;
+    }
+
+    // Id of the node at an absolute path inside the table's subtree
+    uint32_t find(const std::string &p) const
+    {
+        std::string scratch;
+        auto parts = splitPath(canonicalPath(p, scratch)), base = splitPath(rootPath);
+        if (parts.size() < base.size() || !std::equal(base.begin(), base.end(), parts.begin()))
+            throw std::runtime_error(p + " is outside " + rootPath);
+        uint32_t id = 0;
+        for (size_t k = base.size(); k < parts.size(); k++)
+        {
+            // children of id are the subtrees that tile [id + 1, subtreeEnd[id])
+            uint32_t child = id + 1;
+            while (child < subtreeEnd[id] && name(child) != parts[k])
+                child = subtreeEnd[child];
+            if (child >= subtreeEnd[id])
+                throw std::runtime_error("Path " + parts[k] + " not found");
+            id = child;
+        }
+        return id;
+    }
+
+    // Files and bytes per extension for files below id modified at or after
+    // `since`, largest total first
+    std::vector<ExtensionUsage> bytesByExtension(time_t since = 0, uint32_t id = 0) const
+    {
+        uint32_t cutoff = CompactTime(since).secs;
+        std::vector<uint64_t> files(extensions.size()), bytes(extensions.size());
+        auto [from, to] = range(id);
+        for (uint32_t i = from; i < to; i++)
+        {
+            uint64_t hit = isFile[i] & (mtime[i] >= cutoff);
+            files[ext[i]] += hit;
+            bytes[ext[i]] += hit * size[i];
+        }
+        std::vector<ExtensionUsage> out;
+        for (size_t e = 0; e < extensions.size(); e++)
+            if (files[e])
+                out.push_back({extensions[e], files[e], bytes[e]});
+        sort(out.begin(), out.end(), [](auto &a, auto &b)
+             { return a.bytes != b.bytes ? a.bytes > b.bytes : a.extension < b.extension; });
+        return out;
+    }
+
+    // File counts by power-of-two size bucket
+    std::array<uint64_t, SizeBuckets + 1> sizeHistogram(uint32_t id = 0) const
+    {
+        std::array<uint64_t, SizeBuckets + 1> out{};
+        auto [from, to] = range(id);
+        for (uint32_t i = from; i < to; i++)
+            out[size[i] ? 64 - __builtin_clzll(size[i]) : 0] += isFile[i];
+        return out;
+    }
+
+    // File counts by age: bucket k holds files modified in
+    // (now - (k+1)*bucketSeconds, now - k*bucketSeconds]; the last bucket
+    // also takes everything older
+    std::vector<uint64_t> ageHistogram(time_t now, uint32_t bucketSeconds, size_t buckets, uint32_t id = 0) const
+    {
+        std::vector<uint64_t> out(std::max<size_t>(buckets, 1));
+        uint32_t current = CompactTime(now).secs;
+        auto [from, to] = range(id);
+        for (uint32_t i = from; i < to; i++)
+        {
+            uint32_t age = current > mtime[i] ? current - mtime[i] : 0;
+            out[std::min<size_t>(age / std::max(bucketSeconds, 1u), out.size() - 1)] += isFile[i];
+        }
+        return out;
+    }
+
+    // {files, directories} below id, id itself included
+    std::pair<uint64_t, uint64_t> typeCounts(uint32_t id = 0) const
+    {
+        auto [from, to] = range(id);
+        uint64_t files = 0;
+        for (uint32_t i = from; i < to; i++)
+            files += isFile[i];
+        return {files, (to - from) - files};
+    }
+
+    // Total bytes below id
+    uint64_t totalBytes(uint32_t id = 0) const
+    {
+        auto [from, to] = range(id);
+        uint64_t total = 0;
+        for (uint32_t i = from; i < to; i++)
+            total += size[i];
+        return total;
+    }
+
+    // The bytesByExtension query answered by walking the tree directly, for
+    // cross-checking the table and as the baseline in benchmarks
+    static std::vector<ExtensionUsage> walkBytesByExtension(FileSystem &fs, const std::string &path, time_t since)
+    {
+        std::shared_lock lock(fs.treeMutex);
+        std::unordered_map<std::string, ExtensionUsage> acc;
+        std::vector<INode *> stack{fs.traverseNode(path).get()};
+        while (!stack.empty())
+        {
+            INode *node = stack.back();
+            stack.pop_back();
+            if (node->type == NodeType::Directory)
+            {
+                static_cast<DirectoryNode *>(node)->children.forEach(
+                    [&](const std::string &, const std::shared_ptr<INode> &child)
+                    { stack.push_back(child.get()); });
+            }
+            else if ((time_t)node->modified >= since)
+            {
+                auto e = std::string(extensionOf(node->name));
+                auto &u = acc[e];
+                u.extension = e;
+                u.files++;
+                u.bytes += static_cast<FileNode *>(node)->size();
+            }
+        }
+        std::vector<ExtensionUsage> out;
+        for (auto &p : acc)
+            out.push_back(p.second);
+        sort(out.begin(), out.end(), [](auto &a, auto &b)
+             { return a.bytes != b.bytes ? a.bytes > b.bytes : a.extension < b.extension; });
+        return out;
+    }
+};
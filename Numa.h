@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* -------------------- NUMA -------------------- */
+
+// Thin wrappers over the Linux NUMA system calls. libnuma is not needed. On
+// other systems, or on a single node machine, everything reports node 0 and
+// placement requests do nothing.
+
+// Where new memory for a node's data goes, packed in one byte
+struct NumaPlacement
+{
+    static constexpr uint8_t LocalCode = 0;      // the allocating thread's node (first touch)
+    static constexpr uint8_t InterleaveCode = 1; // spread page by page over all nodes
+    static constexpr uint8_t BindBase = 2;       // BindBase + n: on node n
+
+    uint8_t code = LocalCode;
+
+    static NumaPlacement local() { return {LocalCode}; }
+    static NumaPlacement interleave() { return {InterleaveCode}; }
+    static NumaPlacement bind(unsigned node) { return {(uint8_t)(BindBase + std::min(node, 253u))}; }
+
+    bool isLocal() const { return code == LocalCode; }
+    bool isInterleave() const { return code == InterleaveCode; }
+    bool isBind() const { return code >= BindBase; }
+    unsigned node() const { return code - BindBase; }
+    bool operator==(NumaPlacement o) const { return code == o.code; }
+    bool operator!=(NumaPlacement o) const { return code != o.code; }
+};
+
+// Parse a sysfs list such as "0-3,8,10-11"
+inline std::vector<unsigned> parseNumaList(const std::string &s)
+{
+    std::vector<unsigned> out;
+    size_t i = 0;
+    while (i < s.size())
+    {
+        size_t end = s.find(',', i);
+        std::string part = s.substr(i, end == std::string::npos ? std::string::npos : end - i);
+        size_t dash = part.find('-');
+        try
+        {
+            unsigned lo = std::stoul(part.substr(0, dash));
+            unsigned hi = dash == std::string::npos ? lo : std::stoul(part.substr(dash + 1));
+            for (unsigned v = lo; v <= hi; v++)
+                out.push_back(v);
+        }
+        catch (const std::exception &)
+        {
+        }
+        if (end == std::string::npos)
+            break;
+        i = end + 1;
+    }
+    return out;
+}
+
+// Highest online node + 1 (at least 1, at most 64)
+inline unsigned numaNodeCount()
+{
+    static const unsigned count = []
+    {
+        unsigned n = 1;
+#if defined(__linux__)
+        std::ifstream in("/sys/devices/system/node/online");
+        std::string line;
+        if (std::getline(in, line))
+            for (unsigned node : parseNumaList(line))
+                n = std::max(n, node + 1);
+#endif
+        return std::min(n, 64u);
+    }();
+    return count;
+}
+
+// Node of the CPU the calling thread is running on
+inline unsigned currentNumaNode()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+    if (numaNodeCount() > 1)
+    {
+        unsigned cpu = 0, node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 && node < numaNodeCount())
+            return node;
+    }
+#endif
+    return 0;
+}
+
+// Ask for [p, p + len) to be placed on `node`, or interleaved over all nodes
+// when node is negative. Must be called before the memory is first touched.
+// Uses the preferred policy, so a full node spills over instead of failing.
+inline void numaPlace(void *p, size_t len, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    unsigned nodes = numaNodeCount();
+    if (nodes <= 1)
+        return;
+    constexpr int MpolPreferred = 1, MpolInterleave = 3;
+    unsigned long mask = node < 0 ? (nodes >= 64 ? ~0ul : (1ul << nodes) - 1) : 1ul << node;
+    syscall(SYS_mbind, p, len, node < 0 ? MpolInterleave : MpolPreferred, &mask, 64ul, 0u);
+#else
+    (void)p;
+    (void)len;
+    (void)node;
+#endif
+}
+
+// Restrict the calling thread to the CPUs of `node`; false if that was not possible
+inline bool pinThreadToNumaNode(unsigned node)
+{
+#if defined(__linux__)
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string line;
+    if (!std::getline(in, line))
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : parseNumaList(line))
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)node;
+    return false;
+#endif
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "FileSystem.h"
+
+#include <shared_mutex>
+#include <unordered_map>
+
+/* -------------------- ObjectStore -------------------- */
+
+struct ObjectListing
+{
+    std::vector<std::string> keys;           // objects, in key order
+    std::vector<std::string> commonPrefixes; // with a delimiter: groups of keys rolled up, in key order
+    std::string continuation;                // pass to list() for the next page; empty on the last one
+};
+
+// S3-style flat keys over a FileSystem: key "a/b/c" is the file /a/b/c.
+// put creates the directories on the way in the same walk that finds the
+// parent. Listings come from the path index, which the constructor turns
+// on, so they are in key order across depths and cost time proportional to
+// the page. Directories are not objects: they never appear in listings.
+// Everything runs as root.
+//
+// Multipart uploads are for objects whose size is known up front. Each part
+// is copied straight into the object's final buffer at its offset, from any
+// thread and without the tree lock. Completing the upload hands that buffer
+// to the file as its contents, without copying it again.
+class ObjectStore
+{
+private:
+    struct Upload
+    {
+        std::string key;
+        FileData data;
+        size_t partBytes = 0;
+        std::shared_mutex m; // parts fill data shared, complete and abort take it exclusively
+        std::vector<bool> received;
+        bool closed = false; // completed or aborted
+    };
+
+    FileSystem &fs;
+    std::mutex uploadsMutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Upload>> uploads;
+    uint64_t nextUpload = 1;
+
+    // "/" + key, for keys that can name a file: not empty, no leading or
+    // trailing '/', no empty, "." or ".." components
+    static std::string pathOf(const std::string &key)
+    {
+        std::string path = "/" + key;
+        if (key.empty() || !isCanonicalPath(path))
+            throw std::runtime_error("Invalid key " + key);
+        return path;
+    }
+
+    // Smallest string after every string starting with s; empty if none
+    static std::string pastPrefix(std::string s)
+    {
+        while (!s.empty() && (unsigned char)s.back() == 0xff)
+            s.pop_back();
+        if (!s.empty())
+            s.back()++;
+        return s;
+    }
+
+    void link(const std::string &key, FileData &&data)
+    {
+        std::string path = pathOf(key);
+        std::vector<std::shared_ptr<INode>> evicted; // freed after the lock is released
+        std::unique_lock lock(fs.treeMutex);
+        auto [parent, name] = fs.resolveParentCreating(path, Credentials::root(), 0);
+        auto node = parent->getChild(name);
+        if (node && node->type != NodeType::File)
+            throw std::runtime_error(key + " is a directory");
+        if (node)
+        {
+            auto file = std::static_pointer_cast<FileNode>(node);
+            file->setData(std::move(data));
+            file->modified = time(nullptr);
+            fs.noteResized(*file);
+            fs.enforceCacheLimit(file.get(), evicted);
+            return;
+        }
+        BufferAllocator::PlacementScope scope(parent->placement);
+        auto file = makeNode<FileNode>(name);
+        file->setData(std::move(data));
+        parent->addChild(name, file);
+        fs.noteLinked(path, *file);
+        fs.enforceCacheLimit(file.get(), evicted);
+    }
+
+    std::shared_ptr<Upload> findUpload(uint64_t id)
+    {
+        std::lock_guard lock(uploadsMutex);
+        auto it = uploads.find(id);
+        if (it == uploads.end())
+            throw std::runtime_error("No upload " + std::to_string(id));
+        return it->second;
+    }
+
+public:
+    explicit ObjectStore(FileSystem &_fs) : fs(_fs) { fs.setPathIndex(true); }
+
+    // Create or replace the object at key
+    void put(const std::string &key, const char *data, size_t n) { link(key, FileData(data, n)); }
+    void put(const std::string &key, const std::string &bytes) { put(key, bytes.data(), bytes.size()); }
+
+    std::string get(const std::string &key) { return fs.read(pathOf(key)); }
+
+    // False if there was no object at key
+    bool remove(const std::string &key)
+    {
+        std::string path = pathOf(key);
+        std::unique_lock lock(fs.treeMutex);
+        std::shared_ptr<INode> node;
+        try
+        {
+            node = fs.traverseNode(path);
+        }
+        catch (const std::runtime_error &)
+        {
+            return false;
+        }
+        if (node->type != NodeType::File)
+            return false;
+        fs.detachNode(path, false);
+        return true;
+    }
+
+    // Up to maxKeys keys starting with prefix, in key order. With a
+    // delimiter, keys containing it after the prefix are rolled up into one
+    // common prefix (ending at the delimiter) each, which counts as one key.
+    ObjectListing list(const std::string &prefix = "", const std::string &delimiter = "",
+                       const std::string &continuation = "", size_t maxKeys = 1000)
+    {
+        ObjectListing out;
+        std::string scanPrefix = "/" + prefix;
+        std::string from = continuation.empty() ? scanPrefix : continuation;
+        std::shared_lock lock(fs.treeMutex);
+        std::lock_guard indexLock(fs.indexMutex);
+        const PathIndex &index = fs.requirePathIndex();
+        size_t count = 0;
+        while (true)
+        {
+            std::string skip;
+            index.scan(scanPrefix, from, [&](const std::string &path, uint8_t tag)
+                       {
+                if (tag != (uint8_t)NodeType::File)
+                    return true;
+                if (count == maxKeys)
+                {
+                    out.continuation = path;
+                    return false;
+                }
+                count++;
+                std::string_view key = std::string_view(path).substr(1);
+                size_t d = delimiter.empty() ? std::string_view::npos : key.find(delimiter, prefix.size());
+                if (d == std::string_view::npos)
+                {
+                    out.keys.emplace_back(key);
+                    return true;
+                }
+                // emit the group, then carry on past all of it
+                out.commonPrefixes.emplace_back(key.substr(0, d + delimiter.size()));
+                skip = "/" + out.commonPrefixes.back();
+                return false; });
+            if (skip.empty() || (from = pastPrefix(skip)).empty())
+                break;
+        }
+        return out;
+    }
+
+    // Start uploading a totalBytes object to key in parts of partBytes (the
+    // last part may be shorter); returns the upload's id
+    uint64_t beginUpload(const std::string &key, size_t totalBytes, size_t partBytes)
+    {
+        pathOf(key);
+        if (!partBytes)
+            throw std::runtime_error("Part size must not be zero");
+        auto u = std::make_shared<Upload>();
+        u->key = key;
+        u->data = FileData::zeroed(totalBytes);
+        u->partBytes = partBytes;
+        u->received.assign((totalBytes + partBytes - 1) / partBytes, false);
+        std::lock_guard lock(uploadsMutex);
+        uploads[nextUpload] = u;
+        return nextUpload++;
+    }
+
+    // Store part number `part` (from 1), exactly partBytes long except for
+    // the last part. Parts may arrive in any order and from several threads.
+    void uploadPart(uint64_t id, size_t part, const char *data, size_t n)
+    {
+        auto u = findUpload(id);
+        std::shared_lock lock(u->m);
+        if (u->closed)
+            throw std::runtime_error("No upload " + std::to_string(id));
+        if (part == 0 || part > u->received.size())
+            throw std::runtime_error("No part " + std::to_string(part) + " in upload " + std::to_string(id));
+        size_t offset = (part - 1) * u->partBytes;
+        if (n != std::min(u->partBytes, u->data.size() - offset))
+            throw std::runtime_error("Part " + std::to_string(part) + " has the wrong size");
+        memcpy(u->data.data() + offset, data, n);
+        lock.unlock();
+        std::unique_lock done(u->m);
+        u->received[part - 1] = true;
+    }
+
+    // Link the uploaded object at its key; every part must have arrived
+    void completeUpload(uint64_t id)
+    {
+        auto u = findUpload(id);
+        {
+            std::unique_lock lock(u->m);
+            if (std::find(u->received.begin(), u->received.end(), false) != u->received.end())
+                throw std::runtime_error("Upload " + std::to_string(id) + " is missing parts");
+        }
+        {
+            std::lock_guard lock(uploadsMutex);
+            if (!uploads.erase(id))
+                throw std::runtime_error("No upload " + std::to_string(id));
+        }
+        std::unique_lock lock(u->m);
+        u->closed = true;
+        link(u->key, std::move(u->data));
+    }
+
+    void abortUpload(uint64_t id)
+    {
+        auto u = findUpload(id);
+        {
+            std::lock_guard lock(uploadsMutex);
+            uploads.erase(id);
+        }
+        std::unique_lock lock(u->m);
+        u->closed = true;
+        u->data = FileData();
+    }
+};
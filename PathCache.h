@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+struct DirectoryNode;
+
+/* -------------------- PathCache -------------------- */
+
+// Directories by path, so a root lookup can start at its deepest cached
+// ancestor instead of walking down from the root. Keys are the path text up
+// to the directory ("/a/b"); a lookup hashes its parent's prefix and, on a
+// miss, the next shorter ones, so a hit costs one hash of the path and one
+// compare no matter how deep it is.
+//
+// The table is direct mapped: a prefix lives in the one slot its hash picks
+// and a newer prefix simply replaces it. A slot keeps the prefix text, so a
+// hash collision is a miss and never a wrong directory, and the generation
+// it was filled in. The owner bumps its generation whenever a directory is
+// moved or removed, which empties the cache at once. Lookups and fills are
+// safe from threads sharing the tree lock: a slot whose hash does not match
+// is skipped without locking.
+class PathCache
+{
+public:
+    static constexpr size_t DefaultSlots = 4096;
+    static constexpr size_t LockStripes = 64;
+
+    static uint64_t hashOf(std::string_view prefix) { return std::hash<std::string_view>()(prefix); }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> hash{0};
+        uint64_t generation = 0;
+        std::string prefix;
+        std::weak_ptr<DirectoryNode> dir;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    std::mutex stripes[LockStripes];
+
+public:
+    explicit PathCache(size_t count = DefaultSlots) { resize(count); }
+
+    // Number of slots, rounded up to a power of two; 0 turns the cache off.
+    // Needs exclusive access.
+    void resize(size_t count)
+    {
+        size_t n = 1;
+        while (n < count)
+            n <<= 1;
+        slots.reset(count ? new Slot[n] : nullptr);
+        mask = count ? n - 1 : 0;
+    }
+
+    bool enabled() const { return slots != nullptr; }
+    size_t capacity() const { return slots ? mask + 1 : 0; }
+
+    // The directory at prefix, whose hash is h, if it was cached in this
+    // generation
+    std::shared_ptr<DirectoryNode> find(uint64_t h, std::string_view prefix, uint64_t generation)
+    {
+        Slot &s = slots[h & mask];
+        if (s.hash.load(std::memory_order_relaxed) != h)
+            return nullptr;
+        std::lock_guard lock(stripes[(h & mask) % LockStripes]);
+        if (s.hash.load(std::memory_order_relaxed) != h || s.generation != generation || s.prefix != prefix)
+            return nullptr;
+        return s.dir.lock();
+    }
+
+    void insert(uint64_t h, std::string_view prefix, uint64_t generation, const std::shared_ptr<DirectoryNode> &dir)
+    {
+        Slot &s = slots[h & mask];
+        std::lock_guard lock(stripes[(h & mask) % LockStripes]);
+        s.hash.store(h, std::memory_order_relaxed);
+        s.generation = generation;
+        s.prefix = prefix;
+        s.dir = dir;
+    }
+};
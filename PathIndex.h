@@ -0,0 +1,327 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* -------------------- PathIndex -------------------- */
+
+// Set of full paths in a prefix-compressed radix tree. Each edge holds the
+// bytes its subtree has in common, and a node's children are sorted by their
+// first byte, so walking the tree in order yields paths in byte order across
+// all depths ("/a/b" before "/a/b/c" before "/a/c"). A prefix scan descends
+// once to where the prefix ends and then visits only matching paths. Every
+// node either ends a path or branches, so a scan costs time proportional to
+// its output. Each key carries a one-byte tag for the owner's use.
+//
+// Not thread safe; the owner serialises access.
+class PathIndex
+{
+private:
+    struct Node
+    {
+        std::string edge; // bytes from the parent to here
+        bool terminal = false;
+        uint8_t tag = 0;
+        std::vector<Node *> children; // sorted by edge[0], as unsigned bytes
+    };
+
+    Node root;
+    size_t count = 0;
+
+    static unsigned char firstByte(const Node *n) { return (unsigned char)n->edge[0]; }
+
+    static size_t childIndex(const Node &n, unsigned char c)
+    {
+        return std::lower_bound(n.children.begin(), n.children.end(), c,
+                                [](const Node *child, unsigned char b)
+                                { return firstByte(child) < b; }) -
+               n.children.begin();
+    }
+
+    static size_t commonLength(std::string_view a, std::string_view b)
+    {
+        size_t n = std::min(a.size(), b.size()), i = 0;
+        while (i < n && a[i] == b[i])
+            i++;
+        return i;
+    }
+
+    static size_t destroy(Node *n)
+    {
+        size_t keys = n->terminal;
+        for (Node *c : n->children)
+            keys += destroy(c);
+        delete n;
+        return keys;
+    }
+
+    // Fold a node that neither ends a path nor branches into its only child
+    static void compact(Node *n)
+    {
+        if (n->terminal || n->children.size() != 1)
+            return;
+        Node *only = n->children[0];
+        n->edge += only->edge;
+        n->terminal = only->terminal;
+        n->tag = only->tag;
+        n->children = std::move(only->children);
+        delete only;
+    }
+
+    // Drop child i of parent if it holds nothing, then tidy parent
+    void prune(Node *parent, size_t i)
+    {
+        Node *n = parent->children[i];
+        if (!n->terminal && n->children.empty())
+        {
+            delete n;
+            parent->children.erase(parent->children.begin() + i);
+        }
+        else
+            compact(n);
+        if (parent != &root)
+            compact(parent);
+    }
+
+    // Node at or just below where prefix ends, with the full key it stands
+    // for in path; null if no key starts with prefix
+    const Node *locate(std::string_view prefix, std::string &path) const
+    {
+        const Node *n = &root;
+        size_t i = 0;
+        path.clear();
+        while (i < prefix.size())
+        {
+            size_t at = childIndex(*n, (unsigned char)prefix[i]);
+            if (at == n->children.size() || firstByte(n->children[at]) != (unsigned char)prefix[i])
+                return nullptr;
+            n = n->children[at];
+            size_t m = commonLength(n->edge, prefix.substr(i));
+            if (m < n->edge.size() && i + m < prefix.size())
+                return nullptr;
+            path += n->edge;
+            i += n->edge.size();
+        }
+        return n;
+    }
+
+    // In-order walk below n (whose key is path) over keys >= from while
+    // `bounded`, i.e. while path is still a prefix of from. False once visit
+    // asks to stop.
+    template <typename F>
+    static bool walk(const Node *n, std::string &path, std::string_view from, bool bounded, F &visit)
+    {
+        if (bounded)
+        {
+            int c = path.compare(0, path.size(), from.substr(0, path.size()));
+            if (c < 0)
+                return true; // everything below sorts before from
+            bounded = c == 0;
+        }
+        if (n->terminal && (!bounded || path.size() >= from.size()) && !visit(path, n->tag))
+            return false;
+        for (const Node *child : n->children)
+        {
+            size_t len = path.size();
+            path += child->edge;
+            bool more = walk(child, path, from, bounded, visit);
+            path.resize(len);
+            if (!more)
+                return false;
+        }
+        return true;
+    }
+
+public:
+    PathIndex() = default;
+    PathIndex(const PathIndex &) = delete;
+    PathIndex &operator=(const PathIndex &) = delete;
+
+    ~PathIndex() { clear(); }
+
+    size_t size() const { return count; }
+
+    void clear()
+    {
+        for (Node *c : root.children)
+            destroy(c);
+        root.children.clear();
+        root.terminal = false;
+        count = 0;
+    }
+
+    // False if the key was already there (its tag is updated)
+    bool insert(std::string_view key, uint8_t tag = 0)
+    {
+        Node *n = &root;
+        size_t i = 0;
+        while (i < key.size())
+        {
+            unsigned char b = (unsigned char)key[i];
+            size_t at = childIndex(*n, b);
+            if (at == n->children.size() || firstByte(n->children[at]) != b)
+            {
+                Node *leaf = new Node;
+                leaf->edge = key.substr(i);
+                leaf->terminal = true;
+                leaf->tag = tag;
+                n->children.insert(n->children.begin() + at, leaf);
+                count++;
+                return true;
+            }
+            Node *child = n->children[at];
+            size_t m = commonLength(child->edge, key.substr(i));
+            if (m < child->edge.size())
+            {
+                // split the edge where the key leaves it
+                Node *mid = new Node;
+                mid->edge = child->edge.substr(0, m);
+                child->edge.erase(0, m);
+                mid->children.push_back(child);
+                n->children[at] = mid;
+                child = mid;
+            }
+            n = child;
+            i += m;
+        }
+        n->tag = tag;
+        if (n->terminal)
+            return false;
+        n->terminal = true;
+        count++;
+        return true;
+    }
+
+    bool contains(std::string_view key) const
+    {
+        std::string path;
+        const Node *n = locate(key, path);
+        return n && n->terminal && path.size() == key.size();
+    }
+
+    // False if the key was not there
+    bool erase(std::string_view key)
+    {
+        Node *n = &root, *parent = nullptr;
+        size_t i = 0, parentAt = 0;
+        while (i < key.size())
+        {
+            size_t at = childIndex(*n, (unsigned char)key[i]);
+            if (at == n->children.size() || firstByte(n->children[at]) != (unsigned char)key[i])
+                return false;
+            Node *child = n->children[at];
+            if (key.compare(i, child->edge.size(), child->edge) != 0)
+                return false;
+            parent = n;
+            parentAt = at;
+            n = child;
+            i += child->edge.size();
+        }
+        if (!n->terminal)
+            return false;
+        n->terminal = false;
+        count--;
+        if (parent)
+            prune(parent, parentAt);
+        return true;
+    }
+
+    // Remove every key starting with prefix; returns how many there were
+    size_t erasePrefix(std::string_view prefix)
+    {
+        if (prefix.empty())
+        {
+            size_t was = count;
+            clear();
+            return was;
+        }
+        Node *parent = &root, *grand = nullptr;
+        size_t parentAt = 0, i = 0;
+        while (true)
+        {
+            size_t at = childIndex(*parent, (unsigned char)prefix[i]);
+            if (at == parent->children.size() || firstByte(parent->children[at]) != (unsigned char)prefix[i])
+                return 0;
+            Node *child = parent->children[at];
+            size_t m = commonLength(child->edge, prefix.substr(i));
+            if (i + m == prefix.size())
+            {
+                // child and everything below it match
+                size_t keys = destroy(child);
+                parent->children.erase(parent->children.begin() + at);
+                count -= keys;
+                if (grand)
+                    prune(grand, parentAt);
+                return keys;
+            }
+            if (m < child->edge.size())
+                return 0;
+            grand = parent;
+            parentAt = at;
+            parent = child;
+            i += m;
+        }
+    }
+
+    // Visit keys starting with prefix that are >= from, in byte order, until
+    // visit(const std::string &key, uint8_t tag) returns false
+    template <typename F>
+    void scan(std::string_view prefix, std::string_view from, F &&visit) const
+    {
+        std::string path;
+        const Node *n = locate(prefix, path);
+        if (n)
+            walk(n, path, from, true, visit);
+    }
+
+    // Up to limit keys starting with prefix, in byte order
+    std::vector<std::string> withPrefix(std::string_view prefix, size_t limit = SIZE_MAX) const
+    {
+        std::vector<std::string> out;
+        if (limit)
+            scan(prefix, {}, [&](const std::string &k, uint8_t)
+                 {
+                     out.push_back(k);
+                     return out.size() < limit; });
+        return out;
+    }
+
+    // Up to limit keys in [from, to), in byte order
+    std::vector<std::string> range(std::string_view from, std::string_view to, size_t limit = SIZE_MAX) const
+    {
+        std::vector<std::string> out;
+        if (limit)
+            scan({}, from, [&](const std::string &k, uint8_t)
+                 {
+                     if (k >= to)
+                         return false;
+                     out.push_back(k);
+                     return out.size() < limit; });
+        return out;
+    }
+
+    // Length of the longest key that is key itself or an ancestor of it
+    // (followed in key by a '/'); 0 if there is none
+    size_t longestPrefix(std::string_view key) const
+    {
+        const Node *n = &root;
+        size_t i = 0, best = 0;
+        while (i < key.size())
+        {
+            size_t at = childIndex(*n, (unsigned char)key[i]);
+            if (at == n->children.size() || firstByte(n->children[at]) != (unsigned char)key[i])
+                break;
+            n = n->children[at];
+            if (key.compare(i, n->edge.size(), n->edge) != 0)
+                break;
+            i += n->edge.size();
+            if (n->terminal && (i == key.size() || key[i] == '/'))
+                best = i;
+        }
+        return best;
+    }
+};
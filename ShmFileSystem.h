@@ -0,0 +1,877 @@
+#pragma once
+
+#if !defined(__linux__)
+#error "ShmFileSystem.h needs Linux (POSIX shared memory, process-shared mutexes)"
+#endif
+
+#include "FileSystem.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* -------------------- ShmFileSystem -------------------- */
+
+// A file system whose whole tree (nodes, directory tables, file data) lives in
+// one POSIX shared memory segment, so any number of processes can map the same
+// namespace. All links are offsets from the segment base, never pointers.
+//
+// Writers serialise on a process-shared robust mutex (a futex, so uncontended
+// locking stays in user space) and bump a sequence counter around every
+// mutation. Readers never lock: they run the lookup optimistically, copy the
+// result out, and retry if the sequence moved or they observed a torn state.
+// Every offset a reader follows is bounds checked, so racing with a writer can
+// only cause a retry, never a wild access.
+//
+// The segment has a fixed size chosen at creation; running out throws.
+//
+// A process that maps an existing segment starts cold: every page it touches
+// first costs a page fault. advise() maps a range in with one call ahead of
+// use, or drops pages already consumed.
+class ShmFileSystem
+{
+public:
+    enum class Advice
+    {
+        WillNeed,   // map the range's pages in now, in one call
+        Sequential, // it will be read in order: only hints the kernel
+        DontNeed,   // unmap its pages from this process (the data stays)
+    };
+
+private:
+    static constexpr uint64_t Magic = 0x32534d4d454d4649; // "IFMEMMS2"
+    static constexpr int NumClasses = 48;
+    static constexpr uint64_t MinBlock = 32;
+
+    struct Header
+    {
+        std::atomic<uint64_t> magic;
+        uint64_t size;
+        std::atomic<uint64_t> seq; // odd while a writer is mid-mutation
+        pthread_mutex_t writeLock;
+        uint64_t bump;                  // first never-allocated byte
+        uint64_t freeLists[NumClasses]; // power-of-two size classes
+        uint64_t root;
+        uint64_t live; // bytes in blocks handed out and not released
+    };
+
+    // type-specific fields: a/b/c = table/capacity/count for directories,
+    // data/size/capacity for files
+    struct Node
+    {
+        uint32_t type;
+        uint32_t nameLen;
+        uint64_t name;
+        int64_t created;
+        int64_t modified;
+        uint64_t a;
+        uint64_t b;
+        uint64_t c;
+    };
+
+    struct Slot
+    {
+        uint64_t hash;
+        uint64_t node; // 0 = empty
+    };
+
+    // thrown by bounds checks when a reader saw inconsistent state
+    struct TornRead
+    {
+    };
+
+    static constexpr size_t PageBytes = 4096;
+
+    // Fault [p, p + n) of this process's mapping in
+    static void populate(char *p, size_t n)
+    {
+#if defined(MADV_POPULATE_READ)
+        if (madvise(p, n, MADV_POPULATE_READ) == 0)
+            return;
+#endif
+        // older kernels: touch a byte per page
+        for (size_t i = 0; i < n; i += PageBytes)
+            (void)*static_cast<volatile char *>(p + i);
+    }
+
+    char *base = nullptr;
+    size_t mapped = 0;
+
+    Header *hdr() const { return reinterpret_cast<Header *>(base); }
+
+    template <typename T>
+    T *at(uint64_t off, size_t count = 1) const
+    {
+        if (count == 0)
+            return nullptr;
+        if (off < sizeof(Header) || off > mapped || count > (mapped - off) / sizeof(T))
+            throw TornRead{};
+        return reinterpret_cast<T *>(base + off);
+    }
+
+    static uint64_t hashName(std::string_view s)
+    {
+        uint64_t h = 1469598103934665603ull;
+        for (unsigned char c : s)
+            h = (h ^ c) * 1099511628211ull;
+        return h | 1; // never 0
+    }
+
+    static int sizeClass(uint64_t bytes)
+    {
+        int cls = 0;
+        while ((MinBlock << cls) < bytes)
+            cls++;
+        return cls;
+    }
+
+    static uint64_t classBytes(int cls) { return MinBlock << cls; }
+
+    /* ---- allocation (writer only) ---- */
+
+    uint64_t alloc(uint64_t bytes)
+    {
+        int cls = sizeClass(std::max<uint64_t>(bytes, 1));
+        if (cls >= NumClasses)
+            throw std::runtime_error("Allocation too large for shared segment");
+        auto h = hdr();
+        uint64_t sz = classBytes(cls);
+        if (uint64_t off = h->freeLists[cls])
+        {
+            h->freeLists[cls] = *at<uint64_t>(off);
+            h->live += sz;
+            return off;
+        }
+        if (h->bump + sz > h->size)
+            throw std::runtime_error("Shared memory segment full");
+        uint64_t off = h->bump;
+        h->bump += sz;
+        h->live += sz;
+        return off;
+    }
+
+    void release(uint64_t off, uint64_t bytes)
+    {
+        if (!off)
+            return;
+        int cls = sizeClass(std::max<uint64_t>(bytes, 1));
+        *at<uint64_t>(off) = hdr()->freeLists[cls];
+        hdr()->freeLists[cls] = off;
+        hdr()->live -= classBytes(cls);
+    }
+
+    /* ---- synchronisation ---- */
+
+    class WriteGuard
+    {
+    private:
+        Header *h;
+
+    public:
+        explicit WriteGuard(Header *_h) : h(_h)
+        {
+            int rc = pthread_mutex_lock(&h->writeLock);
+            if (rc == EOWNERDEAD)
+            {
+                // a writer died mid-operation; its partial update stays, but
+                // the sequence has to be made even again for readers
+                if (h->seq.load(std::memory_order_relaxed) & 1)
+                    h->seq.fetch_add(1, std::memory_order_relaxed);
+                pthread_mutex_consistent(&h->writeLock);
+            }
+            else if (rc != 0)
+            {
+                throw std::runtime_error("Failed to lock shared segment");
+            }
+            h->seq.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        ~WriteGuard()
+        {
+            h->seq.fetch_add(1, std::memory_order_release);
+            pthread_mutex_unlock(&h->writeLock);
+        }
+    };
+
+    template <typename F>
+    auto optimistic(F &&fn) const
+    {
+        auto h = hdr();
+        while (true)
+        {
+            uint64_t s = h->seq.load(std::memory_order_acquire);
+            if (s & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            try
+            {
+                auto result = fn();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (h->seq.load(std::memory_order_relaxed) == s)
+                    return result;
+            }
+            catch (const TornRead &)
+            {
+            }
+            catch (const std::runtime_error &)
+            {
+                // only trust a lookup failure if nothing changed underneath it
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (h->seq.load(std::memory_order_relaxed) == s)
+                    throw;
+            }
+        }
+    }
+
+    /* ---- nodes and directory tables ---- */
+
+    std::string_view nodeName(const Node *n) const
+    {
+        return std::string_view(at<char>(n->name, n->nameLen), n->nameLen);
+    }
+
+    uint64_t newNode(NodeType type, std::string_view name)
+    {
+        uint64_t off = alloc(sizeof(Node));
+        uint64_t nameOff;
+        try
+        {
+            nameOff = alloc(name.size());
+        }
+        catch (...)
+        {
+            release(off, sizeof(Node));
+            throw;
+        }
+        memcpy(base + nameOff, name.data(), name.size());
+        auto n = at<Node>(off);
+        *n = Node{};
+        n->type = (uint32_t)type;
+        n->nameLen = (uint32_t)name.size();
+        n->name = nameOff;
+        n->created = n->modified = time(nullptr);
+        return off;
+    }
+
+    // Give a node the name already copied to nameOff (from alloc)
+    void renameNode(uint64_t off, uint64_t nameOff, uint32_t nameLen)
+    {
+        auto n = at<Node>(off);
+        release(n->name, n->nameLen);
+        n->name = nameOff;
+        n->nameLen = nameLen;
+    }
+
+    void freeNode(uint64_t off)
+    {
+        auto n = at<Node>(off);
+        if (n->type == (uint32_t)NodeType::Directory)
+        {
+            auto slots = at<Slot>(n->a, n->b);
+            for (uint64_t i = 0; i < n->b; i++)
+                if (slots[i].node)
+                    freeNode(slots[i].node);
+            release(n->a, n->b * sizeof(Slot));
+        }
+        else
+        {
+            release(n->a, n->c);
+        }
+        release(n->name, n->nameLen);
+        release(off, sizeof(Node));
+    }
+
+    // Returns the child offset or 0
+    uint64_t findChild(uint64_t dirOff, std::string_view name) const
+    {
+        auto d = at<Node>(dirOff);
+        uint64_t cap = d->b;
+        if (cap == 0)
+            return 0;
+        auto slots = at<Slot>(d->a, cap);
+        uint64_t h = hashName(name);
+        for (uint64_t i = 0, pos = h & (cap - 1); i < cap; i++, pos = (pos + 1) & (cap - 1))
+        {
+            if (!slots[pos].node)
+                return 0;
+            if (slots[pos].hash == h && nodeName(at<Node>(slots[pos].node)) == name)
+                return slots[pos].node;
+        }
+        return 0;
+    }
+
+    void insertSlot(Slot *slots, uint64_t cap, Slot s)
+    {
+        uint64_t pos = s.hash & (cap - 1);
+        while (slots[pos].node)
+            pos = (pos + 1) & (cap - 1);
+        slots[pos] = s;
+    }
+
+    // Grow the table of dirOff if one more child would overfill it, so the
+    // next addChild allocates nothing
+    void reserveSlot(uint64_t dirOff)
+    {
+        auto d = at<Node>(dirOff);
+        if ((d->c + 1) * 10 > d->b * 7)
+        {
+            uint64_t newCap = d->b ? d->b * 2 : 8;
+            uint64_t table = alloc(newCap * sizeof(Slot));
+            auto fresh = at<Slot>(table, newCap);
+            std::fill(fresh, fresh + newCap, Slot{0, 0});
+            if (d->b)
+            {
+                auto old = at<Slot>(d->a, d->b);
+                for (uint64_t i = 0; i < d->b; i++)
+                    if (old[i].node)
+                        insertSlot(fresh, newCap, old[i]);
+                release(d->a, d->b * sizeof(Slot));
+            }
+            d->a = table;
+            d->b = newCap;
+        }
+    }
+
+    void addChild(uint64_t dirOff, uint64_t childOff)
+    {
+        reserveSlot(dirOff);
+        auto d = at<Node>(dirOff);
+        auto c = at<Node>(childOff);
+        insertSlot(at<Slot>(d->a, d->b), d->b, Slot{hashName(nodeName(c)), childOff});
+        d->c++;
+        d->modified = time(nullptr);
+    }
+
+    // addChild for a node just allocated: if growing the table fails, the
+    // node is freed, so a full segment leaves nothing behind
+    void linkNew(uint64_t dirOff, uint64_t childOff)
+    {
+        try
+        {
+            addChild(dirOff, childOff);
+        }
+        catch (...)
+        {
+            freeNode(childOff);
+            throw;
+        }
+    }
+
+    // Linear probing delete with backward shift, so no tombstones are needed
+    void removeChild(uint64_t dirOff, std::string_view name)
+    {
+        auto d = at<Node>(dirOff);
+        uint64_t cap = d->b;
+        auto slots = at<Slot>(d->a, cap);
+        uint64_t h = hashName(name);
+        uint64_t pos = h & (cap - 1);
+        while (slots[pos].node && !(slots[pos].hash == h && nodeName(at<Node>(slots[pos].node)) == name))
+            pos = (pos + 1) & (cap - 1);
+        if (!slots[pos].node)
+            return;
+        slots[pos] = Slot{0, 0};
+        for (uint64_t next = (pos + 1) & (cap - 1); slots[next].node; next = (next + 1) & (cap - 1))
+        {
+            uint64_t home = slots[next].hash & (cap - 1);
+            bool movable = pos <= next ? (home <= pos || home > next) : (home <= pos && home > next);
+            if (movable)
+            {
+                slots[pos] = slots[next];
+                slots[next] = Slot{0, 0};
+                pos = next;
+            }
+        }
+        d->c--;
+        d->modified = time(nullptr);
+    }
+
+    uint64_t traverse(const std::string &rawPath) const
+    {
+        std::string scratch;
+        const std::string &path = canonicalPath(rawPath, scratch);
+        if (path.empty() || path[0] != '/')
+            throw std::runtime_error("Path must not be empty and should start with \'/\'");
+        uint64_t curr = hdr()->root;
+        for (auto &p : splitPath(path))
+        {
+            if (at<Node>(curr)->type != (uint32_t)NodeType::Directory)
+                throw std::runtime_error("Path traversed into file instead of directory");
+            curr = findChild(curr, p);
+            if (!curr)
+                throw std::runtime_error("Path " + p + " not found");
+        }
+        return curr;
+    }
+
+    std::pair<uint64_t, std::string> resolveParent(const std::string &rawPath) const
+    {
+        std::string scratch;
+        const std::string &path = canonicalPath(rawPath, scratch);
+        if (path.empty() || path[0] != '/')
+            throw std::runtime_error("Path must not be empty and should start with \'/\'");
+        auto parts = splitPath(path);
+        if (parts.empty())
+            throw std::runtime_error("Invalid root parent");
+        uint64_t curr = hdr()->root;
+        for (size_t i = 0; i + 1 < parts.size(); i++)
+        {
+            uint64_t child = findChild(curr, parts[i]);
+            if (!child)
+                throw std::runtime_error("Path " + parts[i] + " not found");
+            if (at<Node>(child)->type != (uint32_t)NodeType::Directory)
+                throw std::runtime_error(parts[i] + " is not a directory");
+            curr = child;
+        }
+        return {curr, parts.back()};
+    }
+
+    // Offset of the node at path, or 0 if it does not exist
+    uint64_t find(const std::string &path) const
+    {
+        try
+        {
+            return traverse(path);
+        }
+        catch (const std::runtime_error &)
+        {
+            return 0;
+        }
+    }
+
+    uint64_t requireFile(uint64_t off, const std::string &path) const
+    {
+        if (at<Node>(off)->type != (uint32_t)NodeType::File)
+            throw std::runtime_error(path + " is a directory");
+        return off;
+    }
+
+    void setFileData(uint64_t fileOff, size_t keep, std::string_view extra)
+    {
+        auto f = at<Node>(fileOff);
+        uint64_t newSize = keep + extra.size();
+        if (newSize > f->c)
+        {
+            uint64_t cap = classBytes(sizeClass(newSize));
+            uint64_t data = alloc(cap);
+            if (keep)
+                memcpy(base + data, base + f->a, keep);
+            release(f->a, f->c);
+            f->a = data;
+            f->c = cap;
+        }
+        if (!extra.empty())
+            memcpy(base + f->a + keep, extra.data(), extra.size());
+        f->b = newSize;
+        f->modified = time(nullptr);
+    }
+
+    // A detached file node holding content
+    uint64_t newFile(std::string_view name, std::string_view content)
+    {
+        uint64_t off = newNode(NodeType::File, name);
+        try
+        {
+            setFileData(off, 0, content);
+        }
+        catch (...)
+        {
+            freeNode(off);
+            throw;
+        }
+        return off;
+    }
+
+    // A detached copy of the subtree at srcOff; if the segment fills up
+    // partway, what was copied is freed again before the error propagates
+    uint64_t copyNode(uint64_t srcOff, std::string_view name)
+    {
+        auto src = at<Node>(srcOff);
+        uint64_t off = newNode((NodeType)src->type, name);
+        auto n = at<Node>(off);
+        n->created = src->created;
+        n->modified = src->modified;
+        try
+        {
+            if (src->type == (uint32_t)NodeType::File)
+            {
+                setFileData(off, 0, std::string_view(base + src->a, src->b));
+                at<Node>(off)->modified = src->modified;
+                return off;
+            }
+            for (uint64_t i = 0; i < src->b; i++)
+            {
+                auto slot = at<Slot>(at<Node>(srcOff)->a, src->b)[i];
+                if (slot.node)
+                    linkNew(off, copyNode(slot.node, nodeName(at<Node>(slot.node))));
+            }
+        }
+        catch (...)
+        {
+            freeNode(off);
+            throw;
+        }
+        return off;
+    }
+
+    // Advice for the segment bytes [off, off + n): pages touching the range
+    // are populated, pages wholly inside it are dropped
+    void adviseRange(uint64_t off, uint64_t n, Advice advice) const
+    {
+        if (off >= mapped || !n)
+            return;
+        n = std::min<uint64_t>(n, mapped - off);
+        uint64_t first = off & ~uint64_t(PageBytes - 1);
+        uint64_t last = (off + n + PageBytes - 1) & ~uint64_t(PageBytes - 1);
+        switch (advice)
+        {
+        case Advice::WillNeed:
+            populate(base + first, std::min<uint64_t>(last, mapped) - first);
+            break;
+        case Advice::Sequential:
+            madvise(base + first, std::min<uint64_t>(last, mapped) - first, MADV_SEQUENTIAL);
+            break;
+        case Advice::DontNeed:
+            first = (off + PageBytes - 1) & ~uint64_t(PageBytes - 1);
+            last = (off + n) & ~uint64_t(PageBytes - 1);
+            if (last > first)
+                madvise(base + first, last - first, MADV_DONTNEED);
+            break;
+        }
+    }
+
+    ShmFileSystem(char *_base, size_t _mapped) : base(_base), mapped(_mapped) {}
+
+    static std::pair<char *, size_t> mapSegment(int fd, size_t bytes)
+    {
+        void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+            throw std::runtime_error(std::string("mmap: ") + strerror(errno));
+        return {static_cast<char *>(p), bytes};
+    }
+
+public:
+    // Create a new segment (fails if name exists). name is a shm_open name, e.g. "/fs"
+    static ShmFileSystem create(const std::string &name, size_t bytes)
+    {
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+            throw std::runtime_error("shm_open " + name + ": " + strerror(errno));
+        if (ftruncate(fd, bytes) < 0)
+        {
+            close(fd);
+            throw std::runtime_error(std::string("ftruncate: ") + strerror(errno));
+        }
+        auto [base, mapped] = mapSegment(fd, bytes);
+        ShmFileSystem fs(base, mapped);
+
+        auto h = fs.hdr();
+        h->size = bytes;
+        h->seq.store(0, std::memory_order_relaxed);
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&h->writeLock, &attr);
+        pthread_mutexattr_destroy(&attr);
+        h->bump = (sizeof(Header) + 63) & ~uint64_t(63);
+        h->live = 0;
+        std::fill(std::begin(h->freeLists), std::end(h->freeLists), 0);
+        h->root = fs.newNode(NodeType::Directory, "/");
+        h->magic.store(Magic, std::memory_order_release); // openers wait for this
+        return fs;
+    }
+
+    // Map an existing segment created by another process
+    static ShmFileSystem open(const std::string &name)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0)
+            throw std::runtime_error("shm_open " + name + ": " + strerror(errno));
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Header))
+        {
+            close(fd);
+            throw std::runtime_error("Shared segment " + name + " is not initialised");
+        }
+        auto [base, mapped] = mapSegment(fd, st.st_size);
+        ShmFileSystem fs(base, mapped);
+        while (fs.hdr()->magic.load(std::memory_order_acquire) != Magic)
+            std::this_thread::yield();
+        return fs;
+    }
+
+    static void unlink(const std::string &name) { shm_unlink(name.c_str()); }
+
+    ShmFileSystem(ShmFileSystem &&other) noexcept : base(std::exchange(other.base, nullptr)), mapped(other.mapped) {}
+    ShmFileSystem(const ShmFileSystem &) = delete;
+
+    ~ShmFileSystem()
+    {
+        if (base)
+            munmap(base, mapped);
+    }
+
+    // Bytes in blocks currently allocated (freed blocks are reused, not
+    // returned); bytesReserved() is how far the segment has ever been used
+    size_t bytesUsed() const { return hdr()->live; }
+    size_t bytesReserved() const { return hdr()->bump; }
+
+    void mkdir(const std::string &path)
+    {
+        WriteGuard guard(hdr());
+        auto [parent, name] = resolveParent(path);
+        if (findChild(parent, name))
+            throw std::runtime_error(name + " already exists");
+        linkNew(parent, newNode(NodeType::Directory, name));
+    }
+
+    void touch(const std::string &path)
+    {
+        WriteGuard guard(hdr());
+        auto [parent, name] = resolveParent(path);
+        if (findChild(parent, name))
+            throw std::runtime_error(name + " already exists");
+        linkNew(parent, newNode(NodeType::File, name));
+    }
+
+    void write(const std::string &path, const std::string &content)
+    {
+        WriteGuard guard(hdr());
+        auto [parent, name] = resolveParent(path);
+        uint64_t file = findChild(parent, name);
+        if (!file)
+        {
+            linkNew(parent, newFile(name, content));
+            return;
+        }
+        if (at<Node>(file)->type != (uint32_t)NodeType::File)
+            throw std::runtime_error("Can't write to directory " + path);
+        setFileData(file, 0, content);
+    }
+
+    void append(const std::string &path, const std::string &content)
+    {
+        WriteGuard guard(hdr());
+        auto [parent, name] = resolveParent(path);
+        uint64_t file = findChild(parent, name);
+        if (!file)
+        {
+            linkNew(parent, newFile(name, content));
+            return;
+        }
+        if (at<Node>(file)->type != (uint32_t)NodeType::File)
+            throw std::runtime_error("Can't append to directory " + path);
+        setFileData(file, at<Node>(file)->b, content);
+    }
+
+    std::string read(const std::string &path) const
+    {
+        return optimistic([&]
+                          {
+            auto f = at<Node>(requireFile(traverse(path), path));
+            return std::string(at<char>(f->a, f->b), f->b); });
+    }
+
+    // Copy up to n bytes from offset into buf; returns how many there were
+    size_t read(const std::string &path, uint64_t offset, char *buf, size_t n) const
+    {
+        return optimistic([&]
+                          {
+            auto f = at<Node>(requireFile(traverse(path), path));
+            size_t got = offset < f->b ? (size_t)std::min<uint64_t>(n, f->b - offset) : 0;
+            if (got)
+                memcpy(buf, at<char>(f->a + offset, got), got);
+            return got; });
+    }
+
+    // Apply advice to [offset, offset + length) of the file at path. Only
+    // this process's mapping is affected, and only as a hint: a range that a
+    // writer moves meanwhile costs faults, never data.
+    void advise(const std::string &path, uint64_t offset, uint64_t length, Advice advice) const
+    {
+        auto [data, size] = optimistic([&]
+                                       {
+            auto f = at<Node>(requireFile(traverse(path), path));
+            return std::make_pair(f->a, f->b); });
+        if (offset < size)
+            adviseRange(data + offset, std::min<uint64_t>(length, size - offset), advice);
+    }
+
+    // Streams a file through a cursor. Each read is a separate optimistic
+    // copy, so a file replaced between reads is read on from its new data.
+    //
+    // A Reader refers to the ShmFileSystem that opened it, which must
+    // outlive it and must not be moved while it is in use.
+    class Reader
+    {
+    private:
+        const ShmFileSystem &fs;
+        std::string path;
+        uint64_t offset = 0; // cursor for read()
+
+    public:
+        Reader(const ShmFileSystem &_fs, std::string _path) : fs(_fs), path(std::move(_path))
+        {
+            fs.optimistic([&]
+                          { return fs.requireFile(fs.traverse(path), path); });
+        }
+
+        uint64_t tell() const { return offset; }
+
+        void seek(uint64_t to) { offset = to; }
+
+        // Up to n bytes from the cursor, which moves past them; 0 at the end
+        size_t read(char *buf, size_t n)
+        {
+            size_t got = pread(offset, buf, n);
+            offset += got;
+            return got;
+        }
+
+        // Up to n bytes from at, leaving the cursor alone
+        size_t pread(uint64_t at, char *buf, size_t n)
+        {
+            return fs.read(path, at, buf, n);
+        }
+
+        void advise(uint64_t at, uint64_t length, Advice advice) const { fs.advise(path, at, length, advice); }
+    };
+
+    // A cursor over the file at path
+    Reader openReader(const std::string &path) const { return Reader(*this, path); }
+
+    std::vector<std::string> ls(const std::string &path) const
+    {
+        auto out = optimistic([&]
+                              {
+            uint64_t off = traverse(path);
+            auto n = at<Node>(off);
+            std::vector<std::string> names;
+            if (n->type == (uint32_t)NodeType::File)
+            {
+                names.emplace_back(nodeName(n));
+                return names;
+            }
+            auto slots = at<Slot>(n->a, n->b);
+            for (uint64_t i = 0; i < n->b; i++)
+                if (slots[i].node)
+                    names.emplace_back(nodeName(at<Node>(slots[i].node)));
+            return names; });
+        sort(out.begin(), out.end());
+        return out;
+    }
+
+    bool exists(const std::string &path) const
+    {
+        try
+        {
+            optimistic([&]
+                       { return traverse(path); });
+            return true;
+        }
+        catch (const std::runtime_error &)
+        {
+            return false;
+        }
+    }
+
+    void rm(const std::string &path, bool recursive = false)
+    {
+        if (path == "/")
+            throw std::runtime_error("Can't remove root");
+        WriteGuard guard(hdr());
+        auto [parent, name] = resolveParent(path);
+        uint64_t node = findChild(parent, name);
+        if (!node)
+            throw std::runtime_error(name + " not found");
+        auto n = at<Node>(node);
+        if (n->type == (uint32_t)NodeType::Directory && n->c && !recursive)
+            throw std::runtime_error("Directory not empty");
+        removeChild(parent, name);
+        freeNode(node);
+    }
+
+    void mv(const std::string &src, const std::string &dest)
+    {
+        if (src == "/")
+            throw std::runtime_error("Cannot move root");
+        WriteGuard guard(hdr());
+        auto [srcParent, srcName] = resolveParent(src);
+        uint64_t node = findChild(srcParent, srcName);
+        if (!node)
+            throw std::runtime_error("Src not found");
+
+        uint64_t existing = find(dest);
+        if (existing == node)
+            return; // onto itself
+        if (at<Node>(node)->type == (uint32_t)NodeType::Directory)
+        {
+            std::string srcScratch, destScratch;
+            const std::string &from = canonicalPath(src, srcScratch);
+            const std::string &to = canonicalPath(dest, destScratch);
+            if (to.size() > from.size() && to.compare(0, from.size(), from) == 0 && to[from.size()] == '/')
+                throw std::runtime_error("Cannot move a directory into itself");
+        }
+        // everything that can run out of space happens before the tree changes
+        if (existing && at<Node>(existing)->type == (uint32_t)NodeType::Directory)
+        {
+            if (findChild(existing, srcName))
+                throw std::runtime_error("Target with same name exists in destination");
+            addChild(existing, node);
+            removeChild(srcParent, srcName);
+            return;
+        }
+        auto [destParent, destName] = resolveParent(dest);
+        uint64_t nameOff = alloc(destName.size());
+        memcpy(base + nameOff, destName.data(), destName.size());
+        try
+        {
+            reserveSlot(destParent);
+        }
+        catch (...)
+        {
+            release(nameOff, destName.size());
+            throw;
+        }
+        if (existing)
+        {
+            // dest is file -> replace file
+            removeChild(destParent, destName);
+            freeNode(existing);
+        }
+        removeChild(srcParent, srcName);
+        renameNode(node, nameOff, (uint32_t)destName.size());
+        addChild(destParent, node);
+    }
+
+    void cp(const std::string &src, const std::string &dest)
+    {
+        WriteGuard guard(hdr());
+        uint64_t node = traverse(src);
+        std::string srcName(nodeName(at<Node>(node)));
+        uint64_t existing = find(dest);
+        if (existing && at<Node>(existing)->type == (uint32_t)NodeType::Directory)
+        {
+            if (findChild(existing, srcName))
+                throw std::runtime_error("Target with same name exists in destination");
+            linkNew(existing, copyNode(node, srcName));
+            return;
+        }
+        if (existing)
+            throw std::runtime_error("Destination exists");
+        auto [destParent, destName] = resolveParent(dest);
+        linkNew(destParent, copyNode(node, destName));
+    }
+};
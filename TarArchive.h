@@ -0,0 +1,538 @@
+#pragma once
+
+#include "FileSystem.h"
+
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <thread>
+
+/* -------------------- TarArchive -------------------- */
+
+struct TarOptions
+{
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    size_t maxQueuedBytes = 256u << 20; // parsed-but-unlinked file data allowed in flight
+};
+
+// Streaming POSIX tar (ustar + pax) import and export.
+//
+// importTar parses headers in a fixed 512 byte buffer and reads each file's
+// contents straight into a FileNode buffer sized from the header (in steps of
+// DataChunk for larger files), so data is copied once, from the stream into
+// the tree. Entries are handed to worker
+// threads by their top-level directory; each worker builds its share of the
+// tree detached from the file system, and the finished subtrees are linked
+// under the target directory in one step at the end.
+//
+// exportTar writes the contents of a directory (paths relative to it) and
+// streams file data directly out of the nodes, holding a read lock throughout.
+class TarArchive
+{
+private:
+    static constexpr size_t Block = 512;
+    static constexpr size_t MaxMetaBytes = 1u << 20; // longest pax or GNU long-name body accepted
+    static constexpr size_t DataChunk = 64u << 20;   // file data read per step
+
+    struct Header
+    {
+        char name[100];
+        char mode[8];
+        char uid[8];
+        char gid[8];
+        char size[12];
+        char mtime[12];
+        char chksum[8];
+        char typeflag;
+        char linkname[100];
+        char magic[6];
+        char version[2];
+        char uname[32];
+        char gname[32];
+        char devmajor[8];
+        char devminor[8];
+        char prefix[155];
+        char pad[12];
+    };
+    static_assert(sizeof(Header) == Block, "tar header must be one block");
+
+    struct Entry
+    {
+        std::vector<std::string> parts;
+        NodeType type;
+        int mode;
+        time_t mtime;
+        FileData data;
+    };
+
+    // Bounded by the bytes of file data queued, so a slow worker throttles the reader
+    class EntryQueue
+    {
+    private:
+        std::mutex m;
+        std::condition_variable cv;
+        std::deque<Entry> entries;
+        size_t bytes = 0;
+        size_t limit;
+        bool closed = false;
+
+    public:
+        explicit EntryQueue(size_t _limit) : limit(_limit) {}
+
+        void push(Entry e)
+        {
+            std::unique_lock lock(m);
+            cv.wait(lock, [&]
+                    { return bytes == 0 || bytes + e.data.size() <= limit; });
+            bytes += e.data.size();
+            entries.push_back(std::move(e));
+            cv.notify_all();
+        }
+
+        bool pop(Entry &e)
+        {
+            std::unique_lock lock(m);
+            cv.wait(lock, [&]
+                    { return closed || !entries.empty(); });
+            if (entries.empty())
+                return false;
+            e = std::move(entries.front());
+            entries.pop_front();
+            bytes -= e.data.size();
+            cv.notify_all();
+            return true;
+        }
+
+        void close()
+        {
+            std::lock_guard lock(m);
+            closed = true;
+            cv.notify_all();
+        }
+    };
+
+    static uint64_t parseNumber(const char *field, size_t len)
+    {
+        // GNU base-256 for values that do not fit in octal
+        if ((unsigned char)field[0] & 0x80)
+        {
+            uint64_t v = (unsigned char)field[0] & 0x7f;
+            for (size_t i = 1; i < len; i++)
+                v = (v << 8) | (unsigned char)field[i];
+            return v;
+        }
+        uint64_t v = 0;
+        size_t i = 0;
+        while (i < len && (field[i] == ' ' || field[i] == '\0'))
+            i++;
+        for (; i < len && field[i] >= '0' && field[i] <= '7'; i++)
+            v = v * 8 + (field[i] - '0');
+        return v;
+    }
+
+    static std::string fieldString(const char *field, size_t len)
+    {
+        return std::string(field, strnlen(field, len));
+    }
+
+    // The stored checksum matches the header's bytes, summed with the
+    // checksum field read as spaces, unsigned or (as some old tars did) signed
+    static bool validChecksum(const char *b)
+    {
+        const auto &h = *reinterpret_cast<const Header *>(b);
+        size_t from = h.chksum - b, to = from + sizeof(h.chksum);
+        uint64_t sum = 0;
+        int64_t signedSum = 0;
+        for (size_t i = 0; i < Block; i++)
+        {
+            char c = i >= from && i < to ? ' ' : b[i];
+            sum += (unsigned char)c;
+            signedSum += (signed char)c;
+        }
+        uint64_t stored = parseNumber(h.chksum, sizeof(h.chksum));
+        return stored == sum || (int64_t)stored == signedSum;
+    }
+
+    static bool isZeroBlock(const char *b)
+    {
+        for (size_t i = 0; i < Block; i++)
+            if (b[i])
+                return false;
+        return true;
+    }
+
+    static void readExact(std::istream &in, char *dst, size_t n)
+    {
+        if (!in.read(dst, n))
+            throw std::runtime_error("Unexpected end of tar archive");
+    }
+
+    static void skip(std::istream &in, uint64_t n)
+    {
+        char buf[64 * 1024];
+        while (n)
+        {
+            size_t chunk = std::min<uint64_t>(n, sizeof(buf));
+            readExact(in, buf, chunk);
+            n -= chunk;
+        }
+    }
+
+    static uint64_t padding(uint64_t size) { return (Block - size % Block) % Block; }
+
+    // Whole of s as a decimal number, or "Invalid tar header"
+    template <typename T>
+    static T parseDecimal(std::string_view s)
+    {
+        T v{};
+        auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+        if (ec != std::errc() || end != s.data() + s.size() || s.empty())
+            throw std::runtime_error("Invalid tar header");
+        return v;
+    }
+
+    // Parse pax "len key=value\n" records into path/size/mtime overrides
+    static void parsePax(const std::string &body, std::string &path, uint64_t &size, bool &hasSize, time_t &mtime)
+    {
+        std::string_view rest(body);
+        while (!rest.empty())
+        {
+            size_t space = rest.find(' ');
+            if (space == std::string_view::npos)
+                throw std::runtime_error("Invalid tar header");
+            size_t len = parseDecimal<size_t>(rest.substr(0, space));
+            if (len <= space + 1 || len > rest.size() || rest[len - 1] != '\n')
+                throw std::runtime_error("Invalid tar header");
+            std::string_view record = rest.substr(space + 1, len - space - 2);
+            rest.remove_prefix(len);
+            size_t eq = record.find('=');
+            if (eq == std::string_view::npos)
+                continue;
+            std::string_view key = record.substr(0, eq), value = record.substr(eq + 1);
+            if (key == "path")
+                path = value;
+            else if (key == "size")
+            {
+                size = parseDecimal<uint64_t>(value);
+                hasSize = true;
+            }
+            else if (key == "mtime")
+                mtime = (time_t)parseDecimal<int64_t>(value.substr(0, value.find('.'))); // whole seconds
+        }
+    }
+
+    // Read a size-byte member into data, growing the buffer as bytes arrive
+    // rather than trusting size up front: a corrupt or hostile size runs
+    // into the end of the stream instead of a huge allocation. Members up
+    // to DataChunk are still read straight into a buffer of their size.
+    static void readData(std::istream &in, FileData &data, uint64_t size)
+    {
+        data.reserve((size_t)std::min<uint64_t>(size, DataChunk));
+        while (data.size() < size)
+        {
+            size_t at = data.size();
+            size_t n = (size_t)std::min<uint64_t>(size - at, DataChunk);
+            data.resizeForOverwrite(at + n);
+            readExact(in, data.data() + at, n);
+        }
+    }
+
+    // Archive path -> components, dropping "." and leading slashes; ".." is refused
+    static bool cleanPath(const std::string &path, std::vector<std::string> &parts)
+    {
+        parts.clear();
+        for (auto &p : splitPath(path))
+        {
+            if (p == ".")
+                continue;
+            if (p == "..")
+                return false;
+            parts.push_back(p);
+        }
+        return !parts.empty();
+    }
+
+    static Permissions permsFromMode(int mode)
+    {
+        Permissions p;
+        p.owner = (mode >> 6) & 7;
+        p.group = (mode >> 3) & 7;
+        p.others = mode & 7;
+        return p;
+    }
+
+    // Walk/create directories for parts[0..n) below root
+    static std::shared_ptr<DirectoryNode> ensureDir(const std::shared_ptr<DirectoryNode> &root,
+                                                    const std::vector<std::string> &parts, size_t n)
+    {
+        auto curr = root;
+        for (size_t i = 0; i < n; i++)
+        {
+            auto child = curr->getChild(parts[i]);
+            if (!child || child->type != NodeType::Directory)
+            {
+                // a later directory entry replaces a same-named file, as tar does
+                auto dir = makeNode<DirectoryNode>(parts[i]);
+                curr->addChild(parts[i], dir);
+                child = dir;
+            }
+            curr = std::static_pointer_cast<DirectoryNode>(child);
+        }
+        return curr;
+    }
+
+    static void applyEntry(const std::shared_ptr<DirectoryNode> &staging, Entry &e)
+    {
+        if (e.type == NodeType::Directory)
+        {
+            auto dir = ensureDir(staging, e.parts, e.parts.size());
+            dir->setPerms(permsFromMode(e.mode));
+            dir->created = dir->modified = e.mtime;
+            return;
+        }
+        auto parent = ensureDir(staging, e.parts, e.parts.size() - 1);
+        auto file = makeNode<FileNode>(e.parts.back());
+        file->setData(std::move(e.data));
+        file->setPerms(permsFromMode(e.mode));
+        file->created = file->modified = e.mtime;
+        parent->addChild(file->name, file);
+    }
+
+    /* ---- export ---- */
+
+    static void putOctal(char *field, size_t len, uint64_t v)
+    {
+        // len-1 octal digits and a NUL
+        field[len - 1] = '\0';
+        for (size_t i = len - 1; i-- > 0;)
+        {
+            field[i] = '0' + (v & 7);
+            v >>= 3;
+        }
+    }
+
+    static void writeHeader(std::ostream &out, const std::string &path, char type, int mode, uint64_t size, time_t mtime)
+    {
+        bool needPax = size >= (1ull << 33) || path.size() > 100;
+        std::string name = path, prefix;
+        if (path.size() > 100)
+        {
+            // try the ustar prefix split before falling back to pax
+            size_t slash = path.find('/', path.size() > 101 ? path.size() - 101 : 0);
+            if (slash != std::string::npos && slash <= 155 && path.size() - slash - 1 <= 100 && slash > 0)
+            {
+                prefix = path.substr(0, slash);
+                name = path.substr(slash + 1);
+                needPax = size >= (1ull << 33);
+            }
+        }
+        if (needPax)
+        {
+            std::string records;
+            auto addRecord = [&](const std::string &key, const std::string &value)
+            {
+                std::string body = " " + key + "=" + value + "\n";
+                size_t len = body.size() + 1;
+                while (std::to_string(len).size() + body.size() != len)
+                    len = std::to_string(len).size() + body.size();
+                records += std::to_string(len) + body;
+            };
+            addRecord("path", path);
+            addRecord("size", std::to_string(size));
+            writeRawHeader(out, "././@PaxHeader", "", 'x', 0644, records.size(), mtime);
+            out.write(records.data(), records.size());
+            writePadding(out, records.size());
+            name = path.substr(0, std::min<size_t>(path.size(), 100));
+            prefix.clear();
+        }
+        writeRawHeader(out, name, prefix, type, mode, size >= (1ull << 33) ? 0 : size, mtime);
+    }
+
+    static void writeRawHeader(std::ostream &out, const std::string &name, const std::string &prefix,
+                               char type, int mode, uint64_t size, time_t mtime)
+    {
+        Header h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.name, name.data(), std::min(name.size(), sizeof(h.name)));
+        memcpy(h.prefix, prefix.data(), std::min(prefix.size(), sizeof(h.prefix)));
+        putOctal(h.mode, sizeof(h.mode), mode);
+        putOctal(h.uid, sizeof(h.uid), 0);
+        putOctal(h.gid, sizeof(h.gid), 0);
+        putOctal(h.size, sizeof(h.size), size);
+        putOctal(h.mtime, sizeof(h.mtime), (uint64_t)std::max<time_t>(mtime, 0));
+        h.typeflag = type;
+        memcpy(h.magic, "ustar", 6);
+        memcpy(h.version, "00", 2);
+        memset(h.chksum, ' ', sizeof(h.chksum));
+        unsigned sum = 0;
+        for (size_t i = 0; i < Block; i++)
+            sum += ((unsigned char *)&h)[i];
+        snprintf(h.chksum, sizeof(h.chksum), "%06o", sum);
+        h.chksum[7] = ' ';
+        out.write((const char *)&h, Block);
+    }
+
+    static void writePadding(std::ostream &out, uint64_t size)
+    {
+        static const char zeros[Block] = {};
+        out.write(zeros, padding(size));
+    }
+
+    static int modeOf(const Permissions &p) { return (p.owner << 6) | (p.group << 3) | p.others; }
+
+    static void exportNode(std::ostream &out, const std::shared_ptr<INode> &node, const std::string &path)
+    {
+        if (node->type == NodeType::File)
+        {
+            auto file = std::static_pointer_cast<FileNode>(node);
+            writeHeader(out, path, '0', modeOf(file->perms()), file->size(), file->modified);
+            out.write(file->data.data(), file->size());
+            writePadding(out, file->size());
+            return;
+        }
+        auto dir = std::static_pointer_cast<DirectoryNode>(node);
+        if (!path.empty())
+            writeHeader(out, path + "/", '5', modeOf(dir->perms()) | 0111, 0, dir->modified);
+        for (auto &name : dir->listNames())
+            exportNode(out, dir->getChild(name), path.empty() ? name : path + "/" + name);
+    }
+
+public:
+    // Extract an archive into the existing directory fsPath. Nothing becomes
+    // visible until the whole archive has been read; top-level names that
+    // already exist in fsPath make the import fail without changing the tree.
+    static void importTar(FileSystem &fs, std::istream &in, const std::string &fsPath, TarOptions opts = {})
+    {
+        size_t workers = std::max<size_t>(opts.workers, 1);
+        std::vector<std::shared_ptr<DirectoryNode>> staging;
+        std::vector<std::unique_ptr<EntryQueue>> queues;
+        for (size_t i = 0; i < workers; i++)
+        {
+            staging.push_back(makeNode<DirectoryNode>("/"));
+            queues.push_back(std::make_unique<EntryQueue>(opts.maxQueuedBytes / workers));
+        }
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < workers; i++)
+            threads.emplace_back([&, i]
+                                 {
+                Entry e;
+                while (queues[i]->pop(e))
+                    applyEntry(staging[i], e); });
+
+        auto finish = [&]
+        {
+            for (auto &q : queues)
+                q->close();
+            for (auto &t : threads)
+                t.join();
+        };
+
+        try
+        {
+            alignas(8) char block[Block];
+            std::string paxPath;
+            uint64_t paxSize = 0;
+            bool paxHasSize = false;
+            time_t paxMtime = -1;
+            std::hash<std::string> hasher;
+
+            while (true)
+            {
+                readExact(in, block, Block);
+                if (isZeroBlock(block))
+                    break;
+                if (!validChecksum(block))
+                    throw std::runtime_error("Invalid tar header");
+                auto &h = *reinterpret_cast<Header *>(block);
+                uint64_t size = paxHasSize ? paxSize : parseNumber(h.size, sizeof(h.size));
+                char type = h.typeflag;
+
+                if (type == 'x' || type == 'L' || type == 'g')
+                {
+                    if (size > MaxMetaBytes)
+                        throw std::runtime_error("Invalid tar header");
+                    std::string body(size, '\0');
+                    readExact(in, body.data(), size);
+                    skip(in, padding(size));
+                    if (type == 'x')
+                        parsePax(body, paxPath, paxSize, paxHasSize, paxMtime);
+                    else if (type == 'L')
+                        paxPath = body.c_str();
+                    continue;
+                }
+
+                std::string path = paxPath;
+                if (path.empty())
+                {
+                    path = fieldString(h.name, sizeof(h.name));
+                    std::string prefix = fieldString(h.prefix, sizeof(h.prefix));
+                    if (!prefix.empty() && memcmp(h.magic, "ustar", 5) == 0)
+                        path = prefix + "/" + path;
+                }
+                Entry e;
+                e.mode = (int)parseNumber(h.mode, sizeof(h.mode)) & 0777;
+                e.mtime = paxMtime >= 0 ? paxMtime : (time_t)parseNumber(h.mtime, sizeof(h.mtime));
+                paxPath.clear();
+                paxHasSize = false;
+                paxMtime = -1;
+
+                bool isFile = type == '0' || type == '\0' || type == '7';
+                bool isDir = type == '5';
+                if ((!isFile && !isDir) || !cleanPath(path, e.parts))
+                {
+                    // links, devices, fifos and unsafe paths are skipped
+                    skip(in, size + padding(size));
+                    continue;
+                }
+                e.type = isDir ? NodeType::Directory : NodeType::File;
+                if (isFile)
+                {
+                    readData(in, e.data, size);
+                }
+                else
+                {
+                    skip(in, size);
+                }
+                skip(in, padding(size));
+                queues[hasher(e.parts[0]) % workers]->push(std::move(e));
+            }
+        }
+        catch (...)
+        {
+            finish();
+            throw;
+        }
+        finish();
+
+        std::vector<std::shared_ptr<INode>> evicted; // freed after the lock is released
+        std::unique_lock lock(fs.treeMutex);
+        auto target = fs.traverseNode(fsPath);
+        if (target->type != NodeType::Directory)
+            throw std::runtime_error(fsPath + " is not a directory");
+        auto dir = std::static_pointer_cast<DirectoryNode>(target);
+        for (auto &s : staging)
+            s->children.forEach([&](const std::string &name, const std::shared_ptr<INode> &)
+                                {
+                if (dir->hasChild(name))
+                    throw std::runtime_error(name + " already exists"); });
+        for (auto &s : staging)
+            s->children.forEach([&](const std::string &name, const std::shared_ptr<INode> &child)
+                                {
+                dir->addChild(name, child);
+                fs.noteLinked(fsPath + "/" + name, *child); });
+        fs.enforceCacheLimit(nullptr, evicted);
+    }
+
+    // Write the contents of fsPath as a tar stream
+    static void exportTar(FileSystem &fs, const std::string &fsPath, std::ostream &out)
+    {
+        std::shared_lock lock(fs.treeMutex);
+        auto node = fs.traverseNode(fsPath);
+        exportNode(out, node, node->type == NodeType::File ? node->name : "");
+        static const char zeros[2 * Block] = {};
+        out.write(zeros, sizeof(zeros));
+        if (!out)
+            throw std::runtime_error("Failed to write tar archive");
+    }
+};
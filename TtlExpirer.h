@@ -0,0 +1,305 @@
+#pragma once
+
+#include "FileSystem.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+
+/* -------------------- TtlExpirer -------------------- */
+
+struct TtlOptions
+{
+    std::chrono::milliseconds tick{10}; // expiry resolution
+    size_t batch = 256;                 // removals per hold of the tree lock
+};
+
+struct TtlStats
+{
+    uint64_t armed = 0;     // expireAt/After/Idle calls
+    uint64_t expired = 0;   // nodes removed
+    uint64_t dropped = 0;   // cancelled, replaced, moved or removed before expiring
+    uint64_t postponed = 0; // idle timers that found the node written to since
+};
+
+// Removes files and directories (with everything below them) once their time
+// is up, on a background thread, so scratch data needs no external sweeper.
+// A TTL is either an absolute expiry or an idle timeout, which counts from
+// the node's last modification and is pushed back whenever it finds a newer
+// one. A TTL belongs to the node at the path when it was set: removing,
+// replacing or moving that node cancels it, and setting another replaces it.
+//
+// Timers live in a hierarchical timing wheel: Levels rings of Slots buckets,
+// level l covering Slots^(l+1) ticks. Arming and firing are O(1); a timer is
+// moved down a level at most Levels - 1 times on its way to level 0. Expired
+// nodes are detached in batches of opts.batch per hold of the tree lock and
+// freed after it is released, so mutations never wait behind a large purge.
+class TtlExpirer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr unsigned SlotBits = 8;
+    static constexpr size_t Slots = size_t(1) << SlotBits;
+    static constexpr unsigned Levels = 4;
+
+private:
+    static constexpr uint64_t Span = uint64_t(1) << (SlotBits * Levels); // ticks the wheel can hold
+
+    struct Timer
+    {
+        uint64_t due; // tick
+        uint64_t serial;
+        const INode *key; // identity in `armed`; only compared, never dereferenced
+        std::weak_ptr<INode> node;
+        std::string path;
+        uint32_t idleSecs; // 0 for an absolute expiry
+    };
+
+    FileSystem &fs;
+    TtlOptions opts;
+    const Clock::time_point origin;
+    std::thread worker;
+    mutable std::mutex m; // taken after the tree lock, never before it
+    std::condition_variable cv;
+    bool stopping = false;
+    std::vector<Timer> wheel[Levels][Slots];
+    uint64_t current = 0; // next tick to process
+    size_t pending = 0;   // timers in the wheel
+    uint64_t nextSerial = 1;
+    std::unordered_map<const INode *, uint64_t> armed; // node -> serial of its live timer
+    TtlStats totals;
+
+    uint64_t tickAt(Clock::time_point t, bool roundUp) const
+    {
+        if (t <= origin)
+            return 0;
+        auto span = t - origin;
+        uint64_t ticks = span / opts.tick;
+        return ticks + (roundUp && span % opts.tick != Clock::duration::zero());
+    }
+
+    // Bucket a timer relative to `current`; timers beyond the wheel's span
+    // wait in the top level and are placed again when they come down
+    void place(Timer &&t)
+    {
+        uint64_t delta = t.due > current ? std::min(t.due - current, Span - 1) : 0;
+        uint64_t at = current + delta;
+        unsigned level = 0;
+        while (level + 1 < Levels && delta >= (uint64_t(1) << (SlotBits * (level + 1))))
+            level++;
+        wheel[level][(at >> (SlotBits * level)) & (Slots - 1)].push_back(std::move(t));
+        pending++;
+    }
+
+    // Run the wheel through tick `upTo`, collecting the timers that fire.
+    // Needs m.
+    void advance(uint64_t upTo, std::vector<Timer> &fired)
+    {
+        if (!pending)
+        {
+            current = std::max(current, upTo + 1);
+            return;
+        }
+        for (; current <= upTo; current++)
+        {
+            // pull down the higher-level buckets whose range starts now,
+            // highest first so their timers can land in lower buckets
+            for (unsigned level = Levels - 1; level > 0; level--)
+            {
+                if (current & ((uint64_t(1) << (SlotBits * level)) - 1))
+                    continue;
+                auto bucket = std::move(wheel[level][(current >> (SlotBits * level)) & (Slots - 1)]);
+                pending -= bucket.size();
+                for (Timer &t : bucket)
+                    place(std::move(t));
+            }
+            auto &bucket = wheel[0][current & (Slots - 1)];
+            auto ready = std::move(bucket);
+            bucket.clear();
+            pending -= ready.size();
+            for (Timer &t : ready)
+            {
+                if (t.due > current)
+                    place(std::move(t));
+                else
+                    fired.push_back(std::move(t));
+            }
+        }
+    }
+
+    // True if t is still its node's live timer; forgets it either way
+    // unless keep is set. Needs m.
+    bool claim(const Timer &t, bool keep)
+    {
+        auto it = armed.find(t.key);
+        if (it == armed.end() || it->second != t.serial)
+            return false;
+        if (!keep)
+            armed.erase(it);
+        return true;
+    }
+
+    void arm(const std::string &rawPath, uint64_t due, uint32_t idleSecs)
+    {
+        std::string scratch;
+        const std::string &path = canonicalPath(rawPath, scratch);
+        if (path == "/")
+            throw std::runtime_error("Can't expire root");
+        std::shared_lock treeLock(fs.treeMutex);
+        auto node = fs.traverseNode(path);
+        {
+            std::lock_guard lock(m);
+            uint64_t serial = nextSerial++;
+            armed[node.get()] = serial;
+            place(Timer{due, serial, node.get(), node, path, idleSecs});
+            totals.armed++;
+        }
+        cv.notify_all();
+    }
+
+    // Remove what the fired timers point at, opts.batch per hold of the
+    // tree lock. Returns how many nodes were removed.
+    size_t expire(std::vector<Timer> &fired)
+    {
+        size_t removed = 0;
+        std::vector<std::shared_ptr<INode>> doomed;
+        std::vector<Timer> later;
+        for (size_t i = 0; i < fired.size();)
+        {
+            TtlStats local;
+            {
+                std::unique_lock treeLock(fs.treeMutex);
+                time_t now = time(nullptr);
+                for (size_t n = 0; i < fired.size() && n < opts.batch; i++, n++)
+                {
+                    Timer &t = fired[i];
+                    auto node = t.node.lock();
+                    bool same = false;
+                    if (node)
+                    {
+                        try
+                        {
+                            same = fs.traverseNode(t.path) == node;
+                        }
+                        catch (const std::runtime_error &)
+                        {
+                        }
+                    }
+                    time_t quiet = same ? now - (time_t)node->modified : 0;
+                    bool postpone = same && t.idleSecs && quiet < (time_t)t.idleSecs;
+                    std::lock_guard lock(m);
+                    if (!claim(t, postpone && same) || !same)
+                    {
+                        local.dropped++;
+                        continue;
+                    }
+                    if (postpone)
+                    {
+                        t.due = current + tickAt(origin + std::chrono::seconds(t.idleSecs - quiet), true);
+                        later.push_back(std::move(t));
+                        local.postponed++;
+                        continue;
+                    }
+                    doomed.push_back(fs.detachNode(t.path, true));
+                    local.expired++;
+                }
+            }
+            // free the subtrees outside the tree lock
+            doomed.clear();
+            removed += local.expired;
+            std::lock_guard lock(m);
+            totals.expired += local.expired;
+            totals.dropped += local.dropped;
+            totals.postponed += local.postponed;
+            for (Timer &t : later)
+                place(std::move(t));
+            later.clear();
+        }
+        fired.clear();
+        return removed;
+    }
+
+public:
+    TtlExpirer(FileSystem &_fs, TtlOptions _opts = {}) : fs(_fs), opts(std::move(_opts)), origin(Clock::now()) {}
+
+    ~TtlExpirer() { stop(); }
+
+    void start()
+    {
+        if (worker.joinable())
+            return;
+        stopping = false;
+        worker = std::thread([this]
+                             {
+            std::vector<Timer> fired;
+            while (true)
+            {
+                {
+                    std::unique_lock lock(m);
+                    // sleep until the next tick is due, or until armed if idle
+                    if (pending)
+                        cv.wait_until(lock, origin + current * opts.tick, [&]
+                                      { return stopping; });
+                    else
+                        cv.wait(lock, [&]
+                                { return stopping || pending; });
+                    if (stopping)
+                        return;
+                    advance(tickAt(Clock::now(), false), fired);
+                }
+                expire(fired);
+            } });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // Remove path at `when`, or `ttl` from now
+    void expireAt(const std::string &path, Clock::time_point when) { arm(path, tickAt(when, true), 0); }
+    void expireAfter(const std::string &path, Clock::duration ttl) { expireAt(path, Clock::now() + ttl); }
+
+    // Remove path once it has not been modified for `idle`
+    void expireIdle(const std::string &path, std::chrono::seconds idle)
+    {
+        if (idle.count() <= 0 || idle.count() > UINT32_MAX)
+            throw std::runtime_error("Idle timeout out of range");
+        arm(path, tickAt(Clock::now() + idle, true), (uint32_t)idle.count());
+    }
+
+    // False if path had no TTL
+    bool cancel(const std::string &path)
+    {
+        std::shared_lock treeLock(fs.treeMutex);
+        auto node = fs.traverseNode(path);
+        std::lock_guard lock(m);
+        return armed.erase(node.get()) > 0;
+    }
+
+    // Expire everything due by now on the calling thread; returns how many
+    // nodes were removed
+    size_t expireDue()
+    {
+        std::vector<Timer> fired;
+        {
+            std::lock_guard lock(m);
+            advance(tickAt(Clock::now(), false), fired);
+        }
+        return expire(fired);
+    }
+
+    TtlStats stats() const
+    {
+        std::lock_guard lock(m);
+        return totals;
+    }
+};